@@ -5,12 +5,14 @@
 #include "raymath.h"
 #include <vector>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include "utils/QuadTree.hpp"
 #include "utils/dorMath.hpp"
 #include "utils/cameraSystem.hpp"
 #include "utils/inputSystem.hpp"
 #include "utils/shaderSystem.hpp"
+#include "utils/jobSystem.hpp"
 #include "sims/flockSim.hpp"
 #include <string>
 #include <list>
@@ -29,7 +31,7 @@
 
 // Init / Shutdown handlers
 // -------------------------------------------
-static void Init()
+static void Init(unsigned threads)
 {
     
     SetConfigFlags(
@@ -38,6 +40,7 @@ static void Init()
     InitWindow(WIDTH, HEIGHT, "raylib");
     SetTargetFPS(60);
     CameraSystem::initCamera();
+    Jobs::init(threads);
     
     SetTargetFPS(60);
 }
@@ -45,6 +48,7 @@ static void Init()
 static void Shutdown()
 {
     ShaderSystem::cleanup();
+    Jobs::shutdown();
     CloseWindow();
 }
 
@@ -56,14 +60,65 @@ static void Update(){
 
 
 
-int main(void)
+int main(int argc, char **argv)
 {
-    Init();
+    // --index=quadtree|linear|grid|loose picks the flock spatial index,
+    // --rebuild-index rebuilds it every step instead of refitting,
+    // --topological steers by the k nearest boids instead of a radius,
+    // --periodic lets boids see and hit each other across the wrapped edges,
+    // --verlet reuses neighbour lists built with a --verlet-skin=D margin,
+    // --resync-collisions syncs and queries the index again for the contacts,
+    // --sort-interval=N / --sort-degrade=F set when the boid arrays are re-sorted (0: never),
+    // --trace-frames=N sets how many frames F6 records into flock_trace.json,
+    // --flock-kernel=scalar|sse|avx2 overrides the CPUID pick,
+    // --parallel-step runs behavior + integration double buffered on the pool,
+    // --parallel-collide solves coloured contact batches on the pool,
+    // --threads=N sizes the pool (default: one per hardware thread),
+    // --tick-rate=HZ sets the fixed simulation rate, --max-substeps=N caps ticks per frame
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "--index=", 8) == 0 && !FlockSimulation::selectIndex(argv[i] + 8))
+            std::cerr << "unknown index '" << (argv[i] + 8) << "', using quadtree\n";
+        else if (std::strcmp(argv[i], "--rebuild-index") == 0)
+            FlockSimulation::incrementalIndex = false;
+        else if (std::strcmp(argv[i], "--topological") == 0)
+            FlockSimulation::topological = true;
+        else if (std::strcmp(argv[i], "--periodic") == 0)
+            FlockSimulation::periodic = true;
+        else if (std::strcmp(argv[i], "--verlet") == 0)
+            FlockSimulation::verletLists = true;
+        else if (std::strncmp(argv[i], "--verlet-skin=", 14) == 0)
+            FlockSimulation::verletSkin = std::max(0.0f, (float)std::atof(argv[i] + 14));
+        else if (std::strcmp(argv[i], "--resync-collisions") == 0)
+            FlockSimulation::fusedStep = false;
+        else if (std::strncmp(argv[i], "--sort-interval=", 16) == 0)
+            FlockSimulation::sortInterval = (uint32_t)std::max(0, std::atoi(argv[i] + 16));
+        else if (std::strncmp(argv[i], "--sort-degrade=", 15) == 0)
+            FlockSimulation::sortDegrade = std::max(0.0f, (float)std::atof(argv[i] + 15));
+        else if (std::strncmp(argv[i], "--trace-frames=", 15) == 0)
+            FlockSimulation::traceFrames = std::max(1, std::atoi(argv[i] + 15));
+        else if (std::strncmp(argv[i], "--flock-kernel=", 15) == 0 && !FlockKernels::select(argv[i] + 15))
+            std::cerr << "unknown flock kernel '" << (argv[i] + 15) << "', using " << FlockKernels::name(FlockKernels::isa) << "\n";
+        else if (std::strcmp(argv[i], "--parallel-step") == 0)
+            FlockSimulation::parallelStep = true;
+        else if (std::strcmp(argv[i], "--parallel-collide") == 0)
+            FlockSimulation::parallelCollisions = true;
+        else if (std::strncmp(argv[i], "--threads=", 10) == 0)
+            threads = (unsigned)std::max(1, std::atoi(argv[i] + 10));
+        else if (std::strncmp(argv[i], "--tick-rate=", 12) == 0)
+            Time::tickRate = std::max(1.0f, (float)std::atof(argv[i] + 12));
+        else if (std::strncmp(argv[i], "--max-substeps=", 15) == 0)
+            Time::maxSubsteps = std::max(1, std::atoi(argv[i] + 15));
+    }
+
+    Init(threads);
     int initialCount = 1000;
     FlockSimulation::prepare(initialCount);
 
     while (!WindowShouldClose())
     {
+        Trace::beginFrame();
         // updates 
         Update();
         
@@ -73,8 +128,11 @@ int main(void)
             BeginMode2D(CameraSystem::camera);
             FlockSimulation::frame();
             EndMode2D();
+            FlockSimulation::drawOverlay();
 
         EndDrawing();
+        PROFILE_FRAME();
+        Trace::endFrame();
 
     }
 
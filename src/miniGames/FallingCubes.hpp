@@ -8,6 +8,7 @@
 #include "../utils/cameraSystem.hpp"
 #include "../utils/timeSystem.hpp"
 #include "../utils/inputSystem.hpp"
+#include "../utils/profiler.hpp"
 
 #define CAMERA_SPEED 0.05f
 
@@ -582,6 +583,11 @@ void DrawGameOverlay(Game* game){
 
     
     DrawFPS(10, 10);
+#ifdef FRAME_PROFILER
+    PROFILE_OVERLAY(10, 40);
+    if (IsKeyPressed(KEY_F5))
+        PROFILE_EXPORT_CSV("cubes_profile.csv");
+#endif
 }
 
 void DrawDebag(Game* game){    Vec3 currPos = game->curr->pos;
@@ -601,6 +607,7 @@ Game* Setup(){
 }
 
 void UpdateGame(Game* game){
+    PROFILE_ZONE("UpdateGame");
 
     UpdateGameState(game);
 
@@ -618,6 +625,7 @@ void UpdateGame(Game* game){
 }
 
 void DrawGame(Game* game){
+    PROFILE_ZONE("DrawGame");
     DrawPlacedBlocks(game);
     if(game->state == GameState::RUNING){
         DrawCurrentBlock(game);
@@ -688,6 +696,8 @@ namespace CameraSystem3D{
             
         EndDrawing();
 
+        PROFILE_FRAME(); // closes the profiler frame (no-op without -DFRAME_PROFILER)
+
     }
 
     TerminateGame(game); // free resources of game (also delete game itself)
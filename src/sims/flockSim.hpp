@@ -3,8 +3,21 @@
 #include "raymath.h"
 #include <vector>
 #include "../utils/QuadTree.hpp"
+#include "../utils/LinearQuadTree.hpp"
+#include "../utils/LooseQuadTree.hpp"
+#include "../utils/SpatialHashGrid.hpp"
+#include "../utils/flockKernels.hpp"
+#include "../utils/PairColouring.hpp"
+#include "../utils/boidRenderer.hpp"
+#include <cstring>
+#include <limits>
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
 #include "../utils/dorMath.hpp"
 #include "../utils/cameraSystem.hpp"
+#include "../utils/timeSystem.hpp"
+#include "../utils/frameZone.hpp"
 
 namespace FlockSimulation{
 // Simulation params
@@ -24,79 +37,298 @@ static float separationRadius = 120.0f;
 static float maxSpeed = 1.8f;           
 static float maxForce = 0.06f;          
 
+// Periodic boundaries: boids see and collide with each other across the
+// wrapped edges (needs a world wider and taller than two perception radii)
+static bool periodic = false;
+
+// Topological flocking: steer by the k nearest boids instead of a metric radius
+static bool topological = false;
+static int topologicalK = 7;
+
 // Behavior weights
 static float wSeparation = 1.35f;
 static float wAlignment = 0.75f;
 static float wCohesion = 0.60f;
 
-struct Ball
+// Boid storage
+// -------------------------------------------
+// Generation-checked reference to one boid: stays put while the boid moves
+// between slots, and stops resolving once it is despawned
+struct BoidHandle
+{
+    uint32_t id;
+    uint32_t generation;
+};
+
+// Structure of arrays: every field is one contiguous array and a boid is a
+// 32-bit handle into them, so the passes below stream through memory instead
+// of chasing pointers. The collision extent is not stored, bounds() derives it.
+//
+// Positions and velocities are double buffered for the parallel step: every
+// boid reads the front arrays and integrates into the back ones, then
+// swapBuffers() flips them.
+//
+// It is also the pool: slots stay dense (removeSlot() swaps the last boid
+// into the gap) and ids of removed boids are reused through a free list.
+struct BoidSoA
 {
-    float x, y;
-    Vector2 vel;
-    Vector2 acc;
-    Rectangle bounds;
+    std::vector<float> x, y;
+    std::vector<float> vx, vy;
+    std::vector<float> ax, ay;
+    std::vector<float> backX, backY, backVx, backVy;
+    // Handles are slots and permute() / removeSlot() move boids between them;
+    // id[slot] is the boid in a slot, slotOf[id] where that boid is now
+    // (kNoSlot once removed). A removed id goes on freeIds with its
+    // generation bumped, so BoidHandles to the old boid no longer resolve.
+    std::vector<uint32_t> id, slotOf;
+    std::vector<uint32_t> generation, freeIds;
+    static const uint32_t kNoSlot = 0xFFFFFFFFu;
 
-    inline void updateKinematics(float dt)
+    uint32_t size() const { return (uint32_t)x.size(); }
+
+    void reserve(size_t n)
     {
-        
-        vel.x += acc.x * dt * ballSpeed;
-        vel.y += acc.y * dt * ballSpeed;
+        x.reserve(n); y.reserve(n);
+        vx.reserve(n); vy.reserve(n);
+        ax.reserve(n); ay.reserve(n);
+        backX.reserve(n); backY.reserve(n);
+        backVx.reserve(n); backVy.reserve(n);
+        id.reserve(n); slotOf.reserve(n);
+        generation.reserve(n); freeIds.reserve(n);
+    }
+
+    // Calls fn on every per-slot float array
+    template <typename Fn>
+    void forEachArray(Fn &&fn)
+    {
+        for (std::vector<float> *v : {&x, &y, &vx, &vy, &ax, &ay, &backX, &backY, &backVx, &backVy})
+            fn(*v);
+    }
+
+    uint32_t add(float px, float py, Vector2 vel)
+    {
+        x.push_back(px); y.push_back(py);
+        vx.push_back(vel.x); vy.push_back(vel.y);
+        ax.push_back(0.0f); ay.push_back(0.0f);
+        backX.push_back(px); backY.push_back(py);
+        backVx.push_back(vel.x); backVy.push_back(vel.y);
+
+        const uint32_t slot = size() - 1;
+        if (freeIds.empty())
+        {
+            id.push_back((uint32_t)slotOf.size());
+            slotOf.push_back(slot);
+            generation.push_back(0);
+        }
+        else
+        {
+            id.push_back(freeIds.back());
+            freeIds.pop_back();
+            slotOf[id.back()] = slot;
+        }
+        return slot;
+    }
+
+    BoidHandle handle(uint32_t slot) const { return BoidHandle{id[slot], generation[id[slot]]}; }
+
+    // Slot of the boid behind h, kNoSlot if it was removed
+    uint32_t resolve(BoidHandle h) const
+    {
+        if (h.id >= slotOf.size() || generation[h.id] != h.generation)
+            return kNoSlot;
+        return slotOf[h.id];
+    }
+
+    // Removes the boid in slot; the last boid moves into the gap
+    void removeSlot(uint32_t slot)
+    {
+        const uint32_t last = size() - 1;
+        const uint32_t gone = id[slot];
+        forEachArray([&](std::vector<float> &v) {
+            v[slot] = v[last];
+            v.pop_back();
+        });
+        id[slot] = id[last];
+        id.pop_back();
+        if (slot != last)
+            slotOf[id[slot]] = slot;
+        slotOf[gone] = kNoSlot;
+        ++generation[gone];
+        freeIds.push_back(gone);
+    }
+
+    // Moves the boid in slot order[k] to slot k, for every k
+    void permute(const std::vector<uint32_t> &order)
+    {
+        const size_t n = order.size();
+        std::vector<float> scratch(n);
+        forEachArray([&](std::vector<float> &v) {
+            for (size_t k = 0; k < n; ++k)
+                scratch[k] = v[order[k]];
+            v.swap(scratch);
+        });
+        std::vector<uint32_t> moved(n);
+        for (size_t k = 0; k < n; ++k)
+        {
+            moved[k] = id[order[k]];
+            slotOf[moved[k]] = (uint32_t)k;
+        }
+        id.swap(moved);
+    }
 
+    void swapBuffers()
+    {
+        x.swap(backX); y.swap(backY);
+        vx.swap(backVx); vy.swap(backVy);
+    }
+
+    Rectangle bounds(uint32_t i) const
+    {
+        return Rectangle{x[i] - ballRadius, y[i] - ballRadius, 2.0f * ballRadius, 2.0f * ballRadius};
+    }
 
+    // Integrates boid i from the front arrays into the given ones (front or back)
+    inline void integrate(uint32_t i, float dt, float *outX, float *outY, float *outVx, float *outVy)
+    {
+        Vector2 vel{vx[i] + ax[i] * dt * ballSpeed, vy[i] + ay[i] * dt * ballSpeed};
         vel = vlimit(vel, maxSpeed);
+        outX[i] = x[i] + vel.x * dt * ballSpeed;
+        outY[i] = y[i] + vel.y * dt * ballSpeed;
+        outVx[i] = vel.x;
+        outVy[i] = vel.y;
+
+        ax[i] = 0.0f;
+        ay[i] = 0.0f;
+    }
 
-        x += vel.x * dt * ballSpeed;
-        y += vel.y * dt * ballSpeed;
+    inline void updateKinematics(uint32_t i, float dt)
+    {
+        integrate(i, dt, x.data(), y.data(), vx.data(), vy.data());
+    }
 
-        acc = Vector2{0, 0};
+    // Double-buffered variant of updateKinematics + wrapEdges
+    inline void integrateToBack(uint32_t i, float dt)
+    {
+        integrate(i, dt, backX.data(), backY.data(), backVx.data(), backVy.data());
+        wrap(backX[i], backY[i]);
+    }
 
-        bounds.x = x - ballRadius;
-        bounds.y = y - ballRadius;
-        bounds.width = 2.0f * ballRadius;
-        bounds.height = 2.0f * ballRadius;
+    inline void addForce(uint32_t i, Vector2 f)
+    {
+        ax[i] += f.x;
+        ay[i] += f.y;
     }
 
-    inline void addForce(Vector2 f) { acc = Vector2Add(acc, f); }
+    typedef FlockKernels::Sums FlockSums;
 
+    FlockKernels::Lanes lanes() const { return FlockKernels::Lanes{x.data(), y.data(), vx.data(), vy.data()}; }
 
-    inline void flock(const std::vector<const Ball *> &neighbors)
+    inline void accumulate(uint32_t i, uint32_t j, FlockSums &s, float pr2 = perceptionRadius * perceptionRadius) const
     {
-        Vector2 sumVel = {0, 0};
-        Vector2 sumPos = {0, 0};
-        Vector2 sepAcc = {0, 0};
+        FlockKernels::accumulateOne(lanes(), i, j, pr2, separationRadius * separationRadius, s);
+    }
 
-        int countPAC = 0; 
-        int countSEP = 0; 
+    // Candidates in [first, last), e.g. one query's slice of a QueryBatch,
+    // plus the neighbours across the wrapped edges in periodic mode; runs the
+    // widest SIMD kernel the CPU has (FlockKernels::isa)
+    template <typename Index>
+    inline void flock(uint32_t i, const uint32_t *first, const uint32_t *last, const Index &index)
+    {
+        FlockSums s;
+        FlockKernels::accumulate(lanes(), i, first, last, perceptionRadius * perceptionRadius,
+                                 separationRadius * separationRadius, s);
+        if (periodic)
+            accumulateImages(i, index, s);
+        applySteering(i, s);
+    }
 
+    // Neighbours of boid i that are only close across a wrapped edge. The
+    // index is queried around the shifted position, and every hit is seen
+    // at its minimum image, i.e. shifted back by the same offset.
+    template <typename Index>
+    inline void accumulateImages(uint32_t i, const Index &index, FlockSums &s) const
+    {
         const float pr2 = perceptionRadius * perceptionRadius;
         const float sr2 = separationRadius * separationRadius;
+        forEachImage(x[i], y[i], perceptionRadius, [&](float ox, float oy) {
+            index.forEachInRadius(Vector2{x[i] + ox, y[i] + oy}, perceptionRadius, [&](uint32_t j) {
+                FlockKernels::accumulateAt(lanes(), x[i], y[i], j, x[j] - ox, y[j] - oy, pr2, sr2, s);
+            });
+        });
+    }
 
-        for (const Ball *b : neighbors)
+    // Topological variant: the k nearest boids count however far away they are,
+    // so the work per boid is bounded in dense clumps. nearest is caller scratch.
+    template <typename Index>
+    inline void flockNearest(uint32_t i, const Index &index, int k, std::vector<uint32_t> &nearest)
+    {
+        FlockSums s;
+        index.knn(Vector2{x[i], y[i]}, (size_t)k + 1, nearest);
+        if (periodic)
         {
-            if (b == this)
-                continue;
-
-            const float dx = b->x - x;
-            const float dy = b->y - y;
-            const float d2 = dx * dx + dy * dy;
-            if (d2 > 0.0001f && d2 <= pr2)
+            nearestImages(i, index, k, nearest);
+            for (uint32_t j : nearest)
             {
-                
-                sumVel = Vector2Add(sumVel, b->vel);
-                sumPos = Vector2Add(sumPos, Vector2{b->x, b->y});
-                ++countPAC;
-
-               
-                if (d2 <= sr2)
-                {
-                    const float d = sqrtf(d2);
-                    Vector2 away = Vector2{x - b->x, y - b->y};
-                    away = Vector2Scale(away, 1.0f / (d + 1e-4f));
-                    sepAcc = Vector2Add(sepAcc, away);
-                    ++countSEP;
-                }
+                float dx = x[j] - x[i], dy = y[j] - y[i];
+                minimumImage(dx, dy);
+                FlockKernels::accumulateAt(lanes(), x[i], y[i], j, x[i] + dx, y[i] + dy,
+                                           std::numeric_limits<float>::infinity(),
+                                           separationRadius * separationRadius, s);
             }
+            applySteering(i, s);
+            return;
+        }
+        for (uint32_t j : nearest)
+        {
+            if (j == i)
+                continue;
+            accumulate(i, j, s, std::numeric_limits<float>::infinity());
         }
+        applySteering(i, s);
+    }
+
+    // Turns the plain knn in nearest into the k nearest by minimum image, i
+    // left out. Nothing is closer across an edge than the plain k-th nearest,
+    // so the wrapped copies of i within that distance of an edge are queried
+    // for k + 1 each, and the k closest of all candidates are kept.
+    template <typename Index>
+    inline void nearestImages(uint32_t i, const Index &index, int k, std::vector<uint32_t> &nearest) const
+    {
+        static thread_local std::vector<uint32_t> image;
+        if (nearest.size() > (size_t)k)
+        {
+            const uint32_t last = nearest.back();
+            const float reach = sqrtf((x[last] - x[i]) * (x[last] - x[i]) + (y[last] - y[i]) * (y[last] - y[i]));
+            forEachImage(x[i], y[i], reach, [&](float ox, float oy) {
+                index.knn(Vector2{x[i] + ox, y[i] + oy}, (size_t)k + 1, image);
+                nearest.insert(nearest.end(), image.begin(), image.end());
+            });
+        }
+        const auto dist2 = [&](uint32_t j) {
+            float dx = x[j] - x[i], dy = y[j] - y[i];
+            minimumImage(dx, dy);
+            return dx * dx + dy * dy;
+        };
+        std::sort(nearest.begin(), nearest.end());
+        nearest.erase(std::unique(nearest.begin(), nearest.end()), nearest.end());
+        nearest.erase(std::remove(nearest.begin(), nearest.end(), i), nearest.end());
+        // ties broken by slot, so the pick does not depend on query order
+        const size_t keep = std::min(nearest.size(), (size_t)k);
+        std::partial_sort(nearest.begin(), nearest.begin() + keep, nearest.end(), [&](uint32_t a, uint32_t b) {
+            const float da = dist2(a), db = dist2(b);
+            return da < db || (da == db && a < b);
+        });
+        nearest.resize(keep);
+    }
+
+    inline void applySteering(uint32_t i, const FlockSums &s)
+    {
+        const Vector2 vel{vx[i], vy[i]};
+        const Vector2 &sumVel = s.sumVel;
+        const Vector2 &sumPos = s.sumPos;
+        const Vector2 &sepAcc = s.sepAcc;
+        const int countPAC = s.countPAC;
+        const int countSEP = s.countSEP;
 
         Vector2 steer = {0, 0};
 
@@ -112,7 +344,7 @@ struct Ball
 
             // Cohesion
             Vector2 center = Vector2Scale(sumPos, 1.0f / (float)countPAC);
-            Vector2 toCenter = Vector2{center.x - x, center.y - y};
+            Vector2 toCenter = Vector2{center.x - x[i], center.y - y[i]};
             Vector2 desiredC = vsafe_normalize(toCenter);
             desiredC = Vector2Scale(desiredC, maxSpeed);
             Vector2 steerC = Vector2Subtract(desiredC, vel);
@@ -130,28 +362,60 @@ struct Ball
             steer = Vector2Add(steer, Vector2Scale(steerS, wSeparation));
         }
 
-        addForce(steer);
+        addForce(i, steer);
     }
 
-    inline void wrapEdges()
+    static inline void wrap(float &px, float &py)
     {
-        if (x > sizeX)
-            x = 0;
-        else if (x < 0)
-            x = (float)sizeX;
-        if (y > sizeY)
-            y = 0;
-        else if (y < 0)
-            y = (float)sizeY;
+        if (px > sizeX)
+            px = 0;
+        else if (px < 0)
+            px = (float)sizeX;
+        if (py > sizeY)
+            py = 0;
+        else if (py < 0)
+            py = (float)sizeY;
+    }
+
+    inline void wrapEdges(uint32_t i) { wrap(x[i], y[i]); }
+
+    // Calls fn(ox, oy) for each wrapped copy (x + ox, y + oy) of a disc of
+    // radius r that pokes out of the world; nothing for discs well inside
+    template <typename Fn>
+    static inline void forEachImage(float px, float py, float r, Fn &&fn)
+    {
+        const float ox = (px - r < 0.0f) ? (float)sizeX : (px + r > sizeX ? -(float)sizeX : 0.0f);
+        const float oy = (py - r < 0.0f) ? (float)sizeY : (py + r > sizeY ? -(float)sizeY : 0.0f);
+        if (ox != 0.0f)
+            fn(ox, 0.0f);
+        if (oy != 0.0f)
+            fn(0.0f, oy);
+        if (ox != 0.0f && oy != 0.0f)
+            fn(ox, oy);
+    }
+
+    // Shortest offset between two points on the wrapped world
+    static inline void minimumImage(float &dx, float &dy)
+    {
+        if (dx > sizeX * 0.5f)
+            dx -= sizeX;
+        else if (dx < -sizeX * 0.5f)
+            dx += sizeX;
+        if (dy > sizeY * 0.5f)
+            dy -= sizeY;
+        else if (dy < -sizeY * 0.5f)
+            dy += sizeY;
     }
 };
 
-static inline void resolveCollision(Ball &a, Ball &b)
+static inline void resolveCollision(BoidSoA &s, uint32_t a, uint32_t b)
 {
     const float r = 2.0f * ballRadius;
 
-    const float dx = b.x - a.x;
-    const float dy = b.y - a.y;
+    float dx = s.x[b] - s.x[a];
+    float dy = s.y[b] - s.y[a];
+    if (periodic)
+        BoidSoA::minimumImage(dx, dy);
     const float dist2 = dx * dx + dy * dy;
 
     if (dist2 <= 0.000001f || dist2 > r * r)
@@ -161,8 +425,8 @@ static inline void resolveCollision(Ball &a, Ball &b)
     const float nx = dx / dist;
     const float ny = dy / dist;
 
-    const float rvx = b.vel.x - a.vel.x;
-    const float rvy = b.vel.y - a.vel.y;
+    const float rvx = s.vx[b] - s.vx[a];
+    const float rvy = s.vy[b] - s.vy[a];
     const float velAlongNormal = rvx * nx + rvy * ny;
 
     if (velAlongNormal <= 0.0f)
@@ -171,10 +435,10 @@ static inline void resolveCollision(Ball &a, Ball &b)
         const float ix = j * nx;
         const float iy = j * ny;
 
-        a.vel.x -= ix;
-        a.vel.y -= iy;
-        b.vel.x += ix;
-        b.vel.y += iy;
+        s.vx[a] -= ix;
+        s.vy[a] -= iy;
+        s.vx[b] += ix;
+        s.vy[b] += iy;
     }
 
     const float penetration = (2.0f * ballRadius) - dist;
@@ -184,125 +448,880 @@ static inline void resolveCollision(Ball &a, Ball &b)
         const float slop = 0.01f;   
         const float corrMag = percent * ((penetration - slop > 0.0f) ? (penetration - slop) : 0.0f) * 0.5f;
 
-        a.x -= nx * corrMag;
-        a.y -= ny * corrMag;
-        b.x += nx * corrMag;
-        b.y += ny * corrMag;
-
-        
-        a.bounds.x = a.x - ballRadius;
-        a.bounds.y = a.y - ballRadius;
-        b.bounds.x = b.x - ballRadius;
-        b.bounds.y = b.y - ballRadius;
+        s.x[a] -= nx * corrMag;
+        s.y[a] -= ny * corrMag;
+        s.x[b] += nx * corrMag;
+        s.y[b] += ny * corrMag;
     }
 }
 
-static QuadTree<Ball> *qt = new QuadTree<Ball>(
-    Vector2{(float)sizeX * 0.5f, (float)sizeY * 0.5f},
+static BoidSoA boids;
+
+// Spatial indices over boid handles; the one in use is picked at startup (selectIndex / --index=)
+enum class IndexType { QuadTree, Linear, HashGrid, Loose };
+static IndexType indexType = IndexType::QuadTree;
+
+static QuadTree<BoidSoA> *qt = new QuadTree<BoidSoA>(
+    boids, Vector2{(float)sizeX * 0.5f, (float)sizeY * 0.5f},
     (float)sizeX, (float)sizeY, 8, 0 
 );
 
-static std::vector<Ball *> balls;
+static LinearQuadTree<BoidSoA> *lqt = new LinearQuadTree<BoidSoA>(
+    boids, Vector2{(float)sizeX * 0.5f, (float)sizeY * 0.5f},
+    (float)sizeX, (float)sizeY, 8, 0
+);
+
+// Stores each boid once, keyed by its bounds
+static LooseQuadTree<BoidSoA> *loose = new LooseQuadTree<BoidSoA>(
+    boids, Vector2{(float)sizeX * 0.5f, (float)sizeY * 0.5f},
+    (float)sizeX, (float)sizeY, 8, 0
+);
+
+// Cell size tied to the perception radius: a behavior query touches 3x3 cells
+static SpatialHashGrid<BoidSoA> *grid = new SpatialHashGrid<BoidSoA>(
+    boids, Vector2{(float)sizeX * 0.5f, (float)sizeY * 0.5f},
+    (float)sizeX, (float)sizeY, perceptionRadius
+);
+
+// Recreates every index for a w x h world; call before prepare()
+static inline void resizeWorld(int w, int h)
+{
+    sizeX = w;
+    sizeY = h;
+    const Vector2 center{(float)sizeX * 0.5f, (float)sizeY * 0.5f};
+    delete qt;
+    delete lqt;
+    delete loose;
+    delete grid;
+    qt = new QuadTree<BoidSoA>(boids, center, (float)sizeX, (float)sizeY, 8, 0);
+    lqt = new LinearQuadTree<BoidSoA>(boids, center, (float)sizeX, (float)sizeY, 8, 0);
+    loose = new LooseQuadTree<BoidSoA>(boids, center, (float)sizeX, (float)sizeY, 8, 0);
+    grid = new SpatialHashGrid<BoidSoA>(boids, center, (float)sizeX, (float)sizeY, perceptionRadius);
+}
+
+// Accepts "quadtree", "linear", "grid" or "loose"; returns false for anything else
+static bool selectIndex(const char *name)
+{
+    if (std::strcmp(name, "quadtree") == 0) indexType = IndexType::QuadTree;
+    else if (std::strcmp(name, "linear") == 0) indexType = IndexType::Linear;
+    else if (std::strcmp(name, "grid") == 0) indexType = IndexType::HashGrid;
+    else if (std::strcmp(name, "loose") == 0) indexType = IndexType::Loose;
+    else return false;
+    return true;
+}
+
+// true: refit the index each step, false: rebuild it from scratch (parallel for the QuadTree)
+static bool incrementalIndex = true;
+
+// Multithreaded double-buffered behavior + integration (flockParallel); the
+// thread count is whatever Jobs::init() was given
+static bool parallelStep = false;
+static uint32_t stepChunk = 256; // boids per parallelFor item
+
+// Verlet neighbour lists: the perception batch is queried with radius
+// verletRadius() and reused, for flocking and collisions, until some boid
+// has moved far enough to leave the skin (metric flocking only)
+static bool verletLists = false;
+static float verletSkin = 40.0f;
+static uint32_t verletBuilds = 0; // list rebuilds so far
+
+// Fused step: the index is synced once per step and the perception batch
+// also supplies the contact candidates, as long as nobody moved far enough
+// to leave it (maxDisplacement()). false: sync again and query the contacts.
+static bool fusedStep = true;
+
+// Coloured parallel contact solver (collideParallel) instead of the serial sweep
+static bool parallelCollisions = false;
+static uint32_t contactChunk = 512; // contact pairs per parallelFor item
+
+// Morton re-sort of the boid arrays (sortBoids): every sortInterval steps,
+// or sooner once storageGap() has grown sortDegrade times since the last
+// sort (or since prepare()), looked at every gapSampleSteps steps. 0 turns
+// either trigger off.
+static uint32_t sortInterval = 600;
+static float sortDegrade = 4.0f;
+static uint32_t gapSampleSteps = 30; // storageGap() is a pass over the flock
+static uint32_t boidSorts = 0; // sorts so far
+static float sortedGap = 0.0f; // storageGap() right after the last sort
+static uint32_t stepsSinceSort = 0;
+
+// Mean distance between boids in adjacent slots. Small while storage follows
+// space; grows as the flock mixes and neighbours drift apart in memory.
+static float storageGap()
+{
+    const uint32_t count = boids.size();
+    if (count < 2)
+        return 0.0f;
+    double sum = 0.0;
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        const float dx = boids.x[i] - boids.x[i - 1];
+        const float dy = boids.y[i] - boids.y[i - 1];
+        sum += sqrtf(dx * dx + dy * dy);
+    }
+    return (float)(sum / (count - 1));
+}
+
+// Frames F6 records into flock_trace.json (Trace::capture)
+static int traceFrames = 120;
+
+// Calls fn with the selected index so the hot loops are compiled per index type
+template <typename Fn>
+static void withIndex(Fn &&fn)
+{
+    switch (indexType)
+    {
+    case IndexType::Linear:   fn(*lqt);  break;
+    case IndexType::HashGrid: fn(*grid); break;
+    case IndexType::Loose:    fn(*loose); break;
+    default:                  fn(*qt);   break;
+    }
+}
+
+// Per-step query scratch, reused across frames
+static std::vector<Rectangle> queries;
+static QueryBatch batch;
+static std::vector<uint64_t> contacts; // (a << 32) | b, a < b
+static PairColouring colouring;
+
+// Wall time spent in each phase of step(), in seconds, summed until reset
+struct PhaseTimes
+{
+    double index = 0;      // refit / rebuild
+    double queries = 0;    // perception and collision broadphase batches
+    double behavior = 0;   // flocking + integration
+    double collisions = 0; // contact resolution
+    double sort = 0;       // maintainOrder
+};
+static PhaseTimes phaseTimes;
+
+static inline double seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 // Setup
 // -------------------------------------------
-static void prepare(int initialCount)
+// The same seed gives the same flock; 1 matches an unseeded rand()
+static void prepare(int initialCount, unsigned seed = 1)
 {
     if (initialCount <= 0) 
         return;
-    balls.reserve(initialCount);
+    srand(seed);
+    boids.reserve(initialCount);
 
     for (int i = 0; i < initialCount; ++i)
     {
         float x = random_ab(0.0f, (float)sizeX);
         float y = random_ab(0.0f, (float)sizeY);
-
-        Ball *b = new Ball{
-            x, y,
-            Vector2{random_ab(-1.0f, 1.0f), random_ab(-1.0f, 1.0f)},
-            Vector2{0.0f, 0.0f},
-            Rectangle{x - ballRadius, y - ballRadius, 2.0f * ballRadius, 2.0f * ballRadius}};
-        balls.emplace_back(b);
+        const Vector2 vel{random_ab(-1.0f, 1.0f), random_ab(-1.0f, 1.0f)};
+        boids.add(x, y, vel);
     }
-    qt->rebuild(balls);
+    // Spawn order is random, the worst storage order there is: with a sort
+    // trigger on, the flock starts out along the Morton curve, and the gap
+    // of whichever order it starts in is the degrade trigger's baseline
+    if (sortInterval > 0 || sortDegrade > 0.0f)
+    {
+        const Rectangle world{0.0f, 0.0f, (float)sizeX, (float)sizeY};
+        std::vector<uint64_t> keys(boids.size());
+        for (uint32_t i = 0; i < boids.size(); ++i)
+            keys[i] = ((uint64_t)morton_encode(boids.x[i], boids.y[i], world) << 32) | i;
+        std::sort(keys.begin(), keys.end());
+        std::vector<uint32_t> order(keys.size());
+        for (size_t k = 0; k < keys.size(); ++k)
+            order[k] = (uint32_t)(keys[k] & 0xFFFFFFFFu);
+        boids.permute(order);
+    }
+    withIndex([](auto &index) { index.rebuild(); });
+    sortedGap = storageGap();
+    stepsSinceSort = 0;
 }
         
 // Frame 
 // -------------------------------------------
-static void frame()
+// Brings the index up to date with the current boid positions
+template <typename Index>
+static void syncIndex(Index &index)
+{
+    FRAME_ZONE("index build");
+    if (incrementalIndex)
+        index.refit();
+    else
+        index.rebuild();
+}
+
+// Behavior and integration in one pass over the Jobs pool. Each boid reads
+// only the front buffer and writes only its own back-buffer slot, and the
+// index it queries is built the same on any thread count, so the result is
+// bit-identical to the serial step whatever the thread count
+// (flockbench --check-threads=N).
+template <typename Index>
+static void flockParallel(const Index &index, float dt)
 {
-    // Input: spawn a ball at cursor
-    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+    const uint32_t count = boids.size();
+    const uint32_t chunk = stepChunk;
+    Jobs::parallelFor((count + chunk - 1) / chunk, [&](uint32_t c) {
+        static thread_local std::vector<uint32_t> nearest;
+        const uint32_t end = std::min(count, (c + 1) * chunk);
+        for (uint32_t j = c * chunk; j < end; ++j)
+        {
+            // batch order keeps a chunk's boids close together in space
+            const uint32_t i = topological ? j : batch.query[j];
+            if (topological)
+                boids.flockNearest(i, index, topologicalK, nearest);
+            else
+                boids.flock(i, batch.begin(j), batch.end(j), index);
+            boids.integrateToBack(i, dt);
+        }
+    });
+    boids.swapBuffers();
+}
+
+// Calls fn(a, b), a < b, for boid pairs within reach of each other only
+// across a wrapped edge; the band along the edges is all that gets queried
+template <typename Index, typename Fn>
+static void forEachImagePair(const Index &index, float reach, Fn &&fn)
+{
+    for (uint32_t a = 0; a < boids.size(); ++a)
     {
-        const Vector2 wp = GetScreenToWorld2D(GetMousePosition(), CameraSystem::camera);
-        Ball *b = new Ball{
-            wp.x, wp.y,
-            Vector2{random_ab(-1.0f, 1.0f), random_ab(-1.0f, 1.0f)},
-            Vector2{0.0f, 0.0f},
-            Rectangle{wp.x - ballRadius, wp.y - ballRadius, 2.0f * ballRadius, 2.0f * ballRadius}};
-        balls.emplace_back(b);
+        BoidSoA::forEachImage(boids.x[a], boids.y[a], reach, [&](float ox, float oy) {
+            index.forEachInRadius(Vector2{boids.x[a] + ox, boids.y[a] + oy}, reach, [&](uint32_t b) {
+                if (b > a)
+                    fn(a, b);
+            });
+        });
+    }
+}
+
+// Contact pairs within reach out of the batch, coloured so that no two
+// pairs of one colour share a boid; each colour then runs across the pool.
+// Pairs resolve in colour order rather than the serial pass's, so the flock
+// differs from the serial collisions, but the pairs and their colouring come
+// from the batch alone and the result is the same on any thread count.
+// imageLists: the batch already holds the neighbours across the seam.
+template <typename Index>
+static void collideParallel(const Index &index, float reach, bool imageLists)
+{
+    FRAME_ZONE("collide");
+    contacts.clear();
+    for (size_t j = 0; j < batch.size(); ++j)
+    {
+        const uint32_t a = batch.query[j];
+        for (const uint32_t *it = batch.begin(j); it != batch.end(j); ++it)
+        {
+            const uint32_t b = *it;
+            if (b <= a)
+                continue;
+            float dx = boids.x[b] - boids.x[a];
+            float dy = boids.y[b] - boids.y[a];
+            if (periodic)
+                BoidSoA::minimumImage(dx, dy);
+            if (dx * dx + dy * dy <= reach * reach)
+                contacts.push_back(((uint64_t)a << 32) | b);
+        }
+    }
+    if (periodic && !imageLists)
+        forEachImagePair(index, reach, [](uint32_t a, uint32_t b) {
+            contacts.push_back(((uint64_t)a << 32) | b);
+        });
+    colouring.build(contacts, boids.size());
+
+    const uint32_t chunk = contactChunk;
+    for (uint32_t c = 0; c <= PairColouring::kSpill; ++c)
+    {
+        const uint32_t first = colouring.offsets[c];
+        const uint32_t n = colouring.offsets[c + 1] - first;
+        const auto solve = [&](uint32_t lo, uint32_t hi) {
+            for (uint32_t k = lo; k < hi; ++k)
+            {
+                const uint64_t p = colouring.pairs[k];
+                resolveCollision(boids, (uint32_t)(p >> 32), (uint32_t)(p & 0xFFFFFFFFu));
+            }
+        };
+        if (c == PairColouring::kSpill)
+            solve(first, first + n);
+        else
+            Jobs::parallelFor((n + chunk - 1) / chunk, [&](uint32_t i) {
+                solve(first + i * chunk, first + std::min(n, (i + 1) * chunk));
+            });
     }
-    qt->rebuild(balls);
+}
+
+// Positions the Verlet lists were built from
+static std::vector<float> verletX, verletY;
+static QueryBatch verletMerged; // addImageNeighbours scratch
+
+// Covers flocking and contacts for anyone who stays within skin / 2
+static float verletRadius()
+{
+    return std::max(perceptionRadius, 2.0f * ballRadius + 1.0f) + verletSkin;
+}
 
-    const float dt = GetFrameTime();
-    std::vector<const Ball *> neighbors;
-    neighbors.reserve(64);
+// Extends the lists of boids within r of an edge with what lies within r of
+// their wrapped copies. A boid that wraps later then still has (and is in)
+// the right lists, so a wrap does not expire them; the passes measure those
+// far entries with their usual metric (raw, or minimum image when periodic).
+template <typename Index>
+static void addImageNeighbours(const Index &index, float r)
+{
+    verletMerged.query.swap(batch.query);
+    verletMerged.offsets.resize(verletMerged.query.size() + 1);
+    verletMerged.items.clear();
+    verletMerged.offsets[0] = 0;
+    for (size_t j = 0; j < verletMerged.query.size(); ++j)
+    {
+        const uint32_t i = verletMerged.query[j];
+        verletMerged.items.insert(verletMerged.items.end(), batch.begin(j), batch.end(j));
+        BoidSoA::forEachImage(boids.x[i], boids.y[i], r, [&](float ox, float oy) {
+            index.forEachInRadius(Vector2{boids.x[i] + ox, boids.y[i] + oy}, r, [&](uint32_t k) {
+                verletMerged.items.push_back(k);
+            });
+        });
+        verletMerged.offsets[j + 1] = (uint32_t)verletMerged.items.size();
+    }
+    std::swap(batch, verletMerged);
+}
 
-    for (Ball *a : balls)
+// True when a boid could leave the skin during the coming step: it already
+// moved more than skin / 2 (minimum image, wraps do not count), less the
+// most one step can add. A spawn also shows up here.
+static bool verletExpired(float dt)
+{
+    const uint32_t count = boids.size();
+    if (verletX.size() != count)
+        return true;
+    const float limit = 0.5f * verletSkin - maxSpeed * ballSpeed * dt;
+    if (limit <= 0.0f)
+        return true;
+    const float limit2 = limit * limit;
+    for (uint32_t i = 0; i < count; ++i)
     {
-        neighbors.clear();
+        float dx = boids.x[i] - verletX[i];
+        float dy = boids.y[i] - verletY[i];
+        BoidSoA::minimumImage(dx, dy);
+        if (dx * dx + dy * dy > limit2)
+            return true;
+    }
+    return false;
+}
 
-        const Rectangle queryBehavior{
-            a->x - perceptionRadius,
-            a->y - perceptionRadius,
-            2.0f * perceptionRadius,
-            2.0f * perceptionRadius};
-        qt->rectQuery(queryBehavior, neighbors);
+// Positions before the latest tick; draw() blends from them by Time::alpha
+static std::vector<float> prevX, prevY;
+
+// Storage order
+// -------------------------------------------
+static std::vector<uint64_t> sortKeys;
+static std::vector<uint32_t> sortOrder;
+
+// Reorders the boids along a Z-order curve over the world, so the neighbour
+// lists of the passes point into nearby memory. Slots change, ids do not
+// (BoidSoA::slotOf); the per-slot arrays kept here move along, the Verlet
+// lists expire and the index is rebuilt.
+template <typename Index>
+static void sortBoids(Index &index)
+{
+    FRAME_ZONE("sort");
+    const uint32_t count = boids.size();
+    const Rectangle world{0.0f, 0.0f, (float)sizeX, (float)sizeY};
+    sortKeys.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+        sortKeys[i] = ((uint64_t)morton_encode(boids.x[i], boids.y[i], world) << 32) | i;
+    std::sort(sortKeys.begin(), sortKeys.end());
+    sortOrder.resize(count);
+    for (uint32_t k = 0; k < count; ++k)
+        sortOrder[k] = (uint32_t)(sortKeys[k] & 0xFFFFFFFFu);
 
-        a->flock(neighbors);
+    boids.permute(sortOrder);
+    if (prevX.size() == count)
+    {
+        std::vector<float> px(count), py(count);
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            px[k] = prevX[sortOrder[k]];
+            py[k] = prevY[sortOrder[k]];
+        }
+        prevX.swap(px);
+        prevY.swap(py);
     }
-    for (Ball *b : balls)
+    verletX.clear();
+    verletY.clear();
+    index.rebuild();
+
+    sortedGap = storageGap();
+    stepsSinceSort = 0;
+    ++boidSorts;
+}
+
+// Sorts when one of the triggers fires
+template <typename Index>
+static void maintainOrder(Index &index)
+{
+    ++stepsSinceSort;
+    const bool due = sortInterval > 0 && stepsSinceSort >= sortInterval;
+    bool degraded = false;
+    if (!due && sortDegrade > 0.0f && stepsSinceSort % std::max(1u, gapSampleSteps) == 0)
     {
-        b->updateKinematics(dt);
-        b->wrapEdges();
+        const float gap = storageGap();
+        // a flock that started too small to measure gets its baseline now
+        if (sortedGap == 0.0f)
+            sortedGap = gap;
+        degraded = gap > sortDegrade * sortedGap;
     }
-    qt->rebuild(balls);
+    if (due || degraded)
+        sortBoids(index);
+}
 
-    std::vector<const Ball *> close;
-    close.reserve(32);
+// Spawning and despawning
+// -------------------------------------------
+// Per boid: where it starts and how fast it goes
+struct BoidInit
+{
+    Vector2 position;
+    Vector2 velocity;
+};
+
+// Bulk changes bigger than 1 / kBulkFraction of the flock rebuild the index
+// instead of editing it boid by boid
+static const uint32_t kBulkFraction = 8;
 
-    for (Ball *a : balls)
+// The grid keeps single inserts in a side list that every query scans, and a
+// fused step does not re-sync the index, so bin them before the next step
+template <typename Index>
+static void settleInserts(Index &) {}
+static void settleInserts(SpatialHashGrid<BoidSoA> &grid) { grid.refit(); }
+
+// Adds n boids, the k-th from generator(k), and appends their handles to out
+// if given. The arrays only allocate while they grow past their capacity.
+template <typename Index, typename Generator>
+static void spawn(Index &index, uint32_t n, Generator &&generator, std::vector<BoidHandle> *out = nullptr)
+{
+    const bool bulk = (uint64_t)n * kBulkFraction > boids.size();
+    for (uint32_t k = 0; k < n; ++k)
     {
-        close.clear();
-        const float inflate = 1.0f;
-        const Rectangle queryCollision{
-            a->bounds.x - inflate,
-            a->bounds.y - inflate,
-            a->bounds.width + 2 * inflate,
-            a->bounds.height + 2 * inflate};
-        qt->rectQuery(queryCollision, close);
+        const BoidInit b = generator(k);
+        const uint32_t slot = boids.add(b.position.x, b.position.y, b.velocity);
+        if (out)
+            out->push_back(boids.handle(slot));
+        if (!bulk)
+            index.insert(slot);
+    }
+    if (bulk && n > 0)
+        index.rebuild();
+    else if (n > 0)
+        settleInserts(index);
+}
 
-        for (const Ball *bp : close)
+// Removes the boids behind handles, skipping the ones already gone, and
+// returns how many went. Each removal swaps the last boid into the gap, so
+// the arrays stay dense; the index follows the move, or is rebuilt for
+// bulk removals, and the Verlet lists expire.
+template <typename Index>
+static uint32_t despawn(Index &index, const std::vector<BoidHandle> &handles)
+{
+    const bool bulk = (uint64_t)handles.size() * kBulkFraction > boids.size();
+    if (!bulk)
+        syncIndex(index); // remove() looks elements up at their current position
+
+    uint32_t removed = 0;
+    for (const BoidHandle &h : handles)
+    {
+        const uint32_t slot = boids.resolve(h);
+        if (slot == BoidSoA::kNoSlot)
+            continue;
+        const uint32_t last = boids.size() - 1;
+        if (!bulk)
         {
-            if (bp == a)
-                continue;
-            if (bp < a)
-                continue; 
-            resolveCollision(*a, *const_cast<Ball *>(bp));
+            index.remove(slot);
+            if (slot != last)
+                index.remove(last);
         }
+        boids.removeSlot(slot);
+        if (prevX.size() == last + 1)
+        {
+            prevX[slot] = prevX[last];
+            prevY[slot] = prevY[last];
+            prevX.pop_back();
+            prevY.pop_back();
+        }
+        if (!bulk && slot != last)
+            index.insert(slot);
+        ++removed;
+    }
+    if (removed == 0)
+        return 0;
+    verletX.clear();
+    verletY.clear();
+    if (bulk)
+        index.rebuild();
+    else
+        settleInserts(index);
+    return removed;
+}
+
+// Positions at the start of the step (fused mode)
+static std::vector<float> stepX, stepY;
+
+// Farthest any boid has moved since stepX / stepY; minimum image, so a boid
+// that wrapped counts by how far it actually went
+static float maxDisplacement()
+{
+    float d2 = 0.0f;
+    for (uint32_t i = 0; i < boids.size(); ++i)
+    {
+        float dx = boids.x[i] - stepX[i];
+        float dy = boids.y[i] - stepY[i];
+        BoidSoA::minimumImage(dx, dy);
+        d2 = std::max(d2, dx * dx + dy * dy);
     }
+    return sqrtf(d2);
+}
+
+// Point indices answer rectangle queries by center; the loose tree tests extents
+template <typename Index>
+static bool storesExtents(const Index &) { return false; }
+static bool storesExtents(const LooseQuadTree<BoidSoA> &) { return true; }
+
+// Advances the flock by dt; touches no window state, so it also runs headless
+template <typename Index>
+static void step(Index &index, float dt)
+{
+    FRAME_ZONE("step");
+    double t0 = seconds();
+    maintainOrder(index);
+    phaseTimes.sort += seconds() - t0;
 
-    for (Ball *b : balls)
+    // Verlet mode keeps batch as the neighbour lists of both passes and only
+    // touches the index when the lists expire (the periodic image queries
+    // still need it current every step)
+    const bool verlet = verletLists && !topological;
+    const bool rebuildLists = verlet && verletExpired(dt);
+    const bool touchIndex = !verlet || rebuildLists || periodic;
+    // The fused step syncs at the end instead, so the index is already
+    // current here (prepare() builds it, spawns insert into it)
+    const bool fused = fusedStep && !verlet && !topological;
+
+    // The index persists across frames; refit only re-homes boids that moved
+    t0 = seconds();
+    if (touchIndex && !fused)
+        syncIndex(index);
+    double t1 = seconds();
+    phaseTimes.index += t1 - t0;
+
+    const uint32_t count = boids.size();
+    queries.resize(count);
+    if (!topological && (!verlet || rebuildLists))
     {
-        Vector2 v = b->vel;
-        if (Vector2Length(v) > 0.0001f)
+        FRAME_ZONE("queries");
+        // One batched query for the whole flock, answered in Morton order
+        const float r = verlet ? verletRadius() : perceptionRadius;
+        for (uint32_t i = 0; i < count; ++i)
+            queries[i] = Rectangle{
+                boids.x[i] - r,
+                boids.y[i] - r,
+                2.0f * r,
+                2.0f * r};
+        index.rectQueryBatch(queries, batch);
+        // Verlet lists outlive wraps (they do not expire on one), so they
+        // need the entries across the seam in either mode
+        if (periodic || verlet)
+            addImageNeighbours(index, r);
+        if (verlet)
         {
-            v = Vector2Scale(vsafe_normalize(v), ballRadius + 12.0f);
-            DrawLine((int)b->x, (int)b->y, (int)(b->x + v.x), (int)(b->y + v.y), YELLOW);
+            verletX = boids.x;
+            verletY = boids.y;
+            ++verletBuilds;
         }
-        DrawCircleLines((int)b->x, (int)b->y, ballRadius, WHITE);
     }
-    qt->setDebugMode(true);
-    qt->drawDebug();
+    if (fused)
+    {
+        stepX = boids.x;
+        stepY = boids.y;
+    }
+    t0 = seconds();
+    phaseTimes.queries += t0 - t1;
+
+    if (parallelStep)
+    {
+        FRAME_ZONE("flock"); // integration included
+        flockParallel(index, dt);
+    }
+    else
+    {
+        {
+            FRAME_ZONE("flock");
+            if (topological)
+            {
+                std::vector<uint32_t> nearest;
+                nearest.reserve(topologicalK + 1);
+                for (uint32_t i = 0; i < count; ++i)
+                    boids.flockNearest(i, index, topologicalK, nearest);
+            }
+            else
+            {
+                for (size_t j = 0; j < batch.size(); ++j)
+                    boids.flock(batch.query[j], batch.begin(j), batch.end(j), index);
+            }
+        }
+        FRAME_ZONE("integrate");
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            boids.updateKinematics(i, dt);
+            boids.wrapEdges(i);
+        }
+    }
+    t1 = seconds();
+    phaseTimes.behavior += t1 - t0;
+
+    // Two boids in contact now were at most contact + 2 * slack apart at the
+    // start of the step, so while that fits in the perception radius they
+    // are in each other's perception lists (wrapped copies included when
+    // periodic) and the collision pass needs no index of its own. Without
+    // periodic, a boid that wrapped this step meets its new neighbours on
+    // the next one.
+    const float inflate = 1.0f;
+    const float contact = 2.0f * ballRadius + inflate;
+    const bool reuse = verlet || (fused && contact + 2.0f * maxDisplacement() <= perceptionRadius);
+    if (touchIndex && !reuse)
+        syncIndex(index);
+    t0 = seconds();
+    phaseTimes.index += t0 - t1;
+
+    // Point indices need the query to reach every center within contact
+    // distance (2 * ballRadius); the loose tree matches the bounds themselves
+    const float reach = (storesExtents(index) ? 0.0f : ballRadius) + inflate;
+    if (!reuse)
+    {
+        FRAME_ZONE("queries");
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const Rectangle a = boids.bounds(i);
+            queries[i] = Rectangle{
+                a.x - reach,
+                a.y - reach,
+                a.width + 2 * reach,
+                a.height + 2 * reach};
+        }
+        index.rectQueryBatch(queries, batch);
+    }
+    t1 = seconds();
+    phaseTimes.queries += t1 - t0;
+
+    if (parallelCollisions)
+        collideParallel(index, contact, reuse);
+    else
+    {
+        FRAME_ZONE("collide");
+        for (size_t j = 0; j < batch.size(); ++j)
+        {
+            const uint32_t a = batch.query[j];
+            for (const uint32_t *it = batch.begin(j); it != batch.end(j); ++it)
+            {
+                const uint32_t b = *it;
+                if (b == a)
+                    continue;
+                if (b < a)
+                    continue; 
+                resolveCollision(boids, a, b);
+            }
+        }
+        // Reused lists already hold the pairs across the seam
+        if (periodic && !reuse)
+            forEachImagePair(index, contact, [](uint32_t a, uint32_t b) {
+                resolveCollision(boids, a, b);
+            });
+    }
+    // Contacts can push a boid past an edge. The indices file such a boid
+    // under the nearest edge leaf / cell but prune on the world bounds, so a
+    // query from outside the world would miss it: wrap it back in first.
+    for (uint32_t i = 0; i < count; ++i)
+        boids.wrapEdges(i);
+    t0 = seconds();
+    phaseTimes.collisions += t0 - t1;
+
+    // The one sync of a fused step, ready for the next step and for drawing
+    if (fused)
+        syncIndex(index);
+    phaseTimes.index += seconds() - t0;
+}
+
+// Where boid i is drawn, alpha of the way from its previous tick to the
+// latest one. A jump across a wrapped edge is drawn at the latest position.
+static inline Vector2 renderPosition(uint32_t i, float alpha)
+{
+    const Vector2 now{boids.x[i], boids.y[i]};
+    if (i >= prevX.size())
+        return now;
+    const float dx = now.x - prevX[i], dy = now.y - prevY[i];
+    if (fabsf(dx) > sizeX * 0.5f || fabsf(dy) > sizeY * 0.5f)
+        return now;
+    return Vector2{prevX[i] + dx * alpha, prevY[i] + dy * alpha};
+}
+
+// cullBoids marks each boid it keeps with the pass number
+static std::vector<uint32_t> cullMark;
+static uint32_t cullPass = 0;
+
+// Boids whose circle or heading line can reach into view (world space).
+// Pure CPU work over the spatial index, so it can be checked headless.
+// The margin covers the drawing extent, interpolation and the collision
+// push that happens after the index was last synced.
+template <typename Index>
+static void cullBoids(const Index &index, const Rectangle &view, std::vector<uint32_t> &out)
+{
+    const float margin = 3.0f * ballRadius + 12.0f + maxSpeed * ballSpeed * Time::fixedDt();
+    const Rectangle region{view.x - margin, view.y - margin, view.width + 2.0f * margin, view.height + 2.0f * margin};
+    const float reach = ballRadius + 12.0f + maxSpeed * ballSpeed * Time::fixedDt();
+
+    if (cullMark.size() != boids.size() || ++cullPass == 0)
+    {
+        cullMark.assign(boids.size(), 0);
+        cullPass = 1;
+    }
+    out.clear();
+    index.rectQuery(region, out);
+    // the broadphase may return whole cells, and a boid on a leaf edge once
+    // per leaf it is in; keep exactly the boids in reach, once each
+    out.erase(std::remove_if(out.begin(), out.end(), [&](uint32_t i) {
+                  if (boids.x[i] < view.x - reach || boids.x[i] > view.x + view.width + reach ||
+                      boids.y[i] < view.y - reach || boids.y[i] > view.y + view.height + reach ||
+                      cullMark[i] == cullPass)
+                      return true;
+                  cullMark[i] = cullPass;
+                  return false;
+              }),
+              out.end());
+}
+
+static std::vector<uint32_t> visible; // cullBoids output, reused across frames
+static std::vector<Vector2> drawPos, drawDir; // per visible boid: render position, unit heading
+
+// Window-only code; FLOCK_HEADLESS leaves it out, so a headless build
+// (flockbench) does not reference the windowing and GL parts of raylib
+#ifndef FLOCK_HEADLESS
+template <typename Index>
+static void draw(Index &index, float alpha)
+{
+    FRAME_ZONE("draw");
+    const Rectangle view = CameraSystem::visibleWorldRect(CameraSystem::camera, (float)GetScreenWidth(),
+                                                          (float)GetScreenHeight());
+    cullBoids(index, view, visible);
+
+    // One vertex buffer for the visible set, detail picked from the zoom
+    drawPos.resize(visible.size());
+    drawDir.resize(visible.size());
+    for (size_t k = 0; k < visible.size(); ++k)
+    {
+        const uint32_t i = visible[k];
+        const Vector2 v{boids.vx[i], boids.vy[i]};
+        drawPos[k] = renderPosition(i, alpha);
+        drawDir[k] = Vector2Length(v) > 0.0001f ? vsafe_normalize(v) : Vector2{0.0f, 0.0f};
+    }
+    const float zoom = CameraSystem::camera.zoom;
+    BoidRenderer::draw(BoidRenderer::pick(ballRadius, zoom), drawPos.data(), drawDir.data(), visible.size(),
+                       ballRadius, zoom);
+    index.setDebugMode(true);
+    index.drawDebug(view);
+}
+
+// Right-click sink
+static float sinkRadius = 80.0f;
+static std::vector<BoidHandle> sunk; // scratch
+
+static inline void frame()
+{
+    withIndex([](auto &index) {
+        FRAME_ZONE("frame");
+        // Input: spawn a ball at cursor, hold right to despawn the ones around it
+        const Vector2 wp = GetScreenToWorld2D(GetMousePosition(), CameraSystem::camera);
+        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+            spawn(index, 1, [&](uint32_t) {
+                const Vector2 vel{random_ab(-1.0f, 1.0f), random_ab(-1.0f, 1.0f)};
+                return BoidInit{wp, vel};
+            });
+        if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT))
+        {
+            sunk.clear();
+            index.forEachInRadius(wp, sinkRadius, [](uint32_t i) { sunk.push_back(boids.handle(i)); });
+            despawn(index, sunk);
+        }
+        // Time::update() turned the frame time into whole fixed ticks; the
+        // simulation never sees a variable dt, a slow frame just runs more ticks
+        for (int t = 0; t < Time::ticks; ++t)
+        {
+            prevX = boids.x;
+            prevY = boids.y;
+            step(index, Time::fixedDt());
+        }
+        draw(index, Time::alpha);
+    });
+}
+#endif
+
+// FNV-1a over the bits of every position and velocity, in id order so the
+// storage order does not count: equal checksums mean bit-identical flocks
+static inline uint64_t checksum()
+{
+    uint64_t h = 1469598103934665603ull;
+    const auto mix = [&h](const std::vector<float> &v) {
+        for (uint32_t slot : boids.slotOf)
+        {
+            if (slot == BoidSoA::kNoSlot)
+                continue;
+            uint32_t bits;
+            std::memcpy(&bits, &v[slot], sizeof(bits));
+            h = (h ^ bits) * 1099511628211ull;
+        }
+    };
+    mix(boids.x);
+    mix(boids.y);
+    mix(boids.vx);
+    mix(boids.vy);
+    return h;
+}
+
+// Drops the flock and everything a run has built up, then prepare()s a new
+// one: the same count and seed replay the same run
+static inline void restart(int initialCount, unsigned seed = 1)
+{
+    boids = BoidSoA();
+    verletX.clear();
+    verletY.clear();
+    prevX.clear();
+    prevY.clear();
+    stepX.clear();
+    stepY.clear();
+    sortedGap = 0.0f;
+    stepsSinceSort = 0;
+    boidSorts = 0;
+    verletBuilds = 0;
+    phaseTimes = PhaseTimes();
+    prepare(initialCount, seed);
+}
+
+#ifndef FLOCK_HEADLESS
+// Screen space overlay, drawn after EndMode2D
+// -------------------------------------------
+static inline void drawOverlay()
+{
+#ifdef QUADTREE_STATS
+    // Quadtree shape and per-frame query cost; F4 dumps them to quadtree_stats.json
+    if (indexType != IndexType::QuadTree)
+        return;
+    const QuadTreeStats st = qt->stats();
+    st.drawOverlay(10, 40);
+    if (IsKeyPressed(KEY_F4))
+        std::ofstream("quadtree_stats.json") << st.toJson();
+    qt->resetQueryStats();
+#endif
+    // Timeline of the next traceFrames frames for chrome://tracing or ui.perfetto.dev
+    if (IsKeyPressed(KEY_F6) && !Trace::capturing())
+        Trace::capture("flock_trace.json", traceFrames);
+#ifdef FRAME_PROFILER
+    // Rolling per-zone percentiles; F5 writes the kept frames to flock_profile.csv
+    PROFILE_OVERLAY(GetScreenWidth() - 520, 10);
+    if (IsKeyPressed(KEY_F5))
+        PROFILE_EXPORT_CSV("flock_profile.csv");
+#endif
 }
+#endif
 }
\ No newline at end of file
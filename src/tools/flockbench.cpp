@@ -0,0 +1,401 @@
+// Headless flock benchmark: runs the flock for a fixed number of fixed-dt
+// steps without opening a window and reports throughput, per-phase times and
+// a checksum of the final state. Build with `make flockbench`.
+//
+//   ./flockbench --boids=20000 --steps=600 --seed=1 --world=8192x8192
+//
+// Also takes the simulation flags of the main program: --index=, --rebuild-index,
+// --topological, --periodic, --verlet, --verlet-skin=, --resync-collisions,
+// --sort-interval=N, --sort-degrade=F, --flock-kernel=, --parallel-step, --parallel-collide, --threads=N
+// (default here: 1, so runs are comparable across machines).
+//
+// --churn=K despawns K random boids and spawns K new ones at random places
+// before every step (an emitter / sink load at a constant flock size).
+//
+// --trace=FILE writes a Chrome / Perfetto trace of the last --trace-frames=N
+// steps (default 10), worker threads included.
+//
+// --render-zoom=Z also times the CPU side of drawing every step: culling to a
+// 2000x1500 view centred on the world at zoom Z plus vertex generation.
+//
+// --check-threads=N runs the configuration on 1 thread and on N threads,
+// with the serial and the parallel step and collisions, instead of timing it; fails
+// unless every run ends on the same checksum.
+//
+// --compare-sort times the configuration twice, with the storage sort
+// triggers as given and with both off, and prints the two step rates.
+//
+// --check-kernels runs every flock kernel the CPU supports over random
+// candidate lists (empty ones and lengths off the vector width included)
+// and fails unless each agrees with the scalar kernel.
+
+// Includes
+// -------------------------------------------
+#define FLOCK_HEADLESS
+#include "raylib.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <iostream>
+#include "../utils/jobSystem.hpp"
+#include "../sims/flockSim.hpp"
+
+// Despawns churn random boids and spawns as many at random places
+template <typename Index>
+static void churnFlock(Index &index, int churn)
+{
+    static std::vector<FlockSimulation::BoidHandle> doomed;
+    doomed.clear();
+    for (int k = 0; k < churn && FlockSimulation::boids.size() > 0; ++k)
+    {
+        const uint32_t slot = (uint32_t)std::rand() % FlockSimulation::boids.size();
+        doomed.push_back(FlockSimulation::boids.handle(slot));
+    }
+    FlockSimulation::despawn(index, doomed);
+    FlockSimulation::spawn(index, (uint32_t)churn, [](uint32_t) {
+        const float x = random_ab(0.0f, (float)FlockSimulation::sizeX);
+        const float y = random_ab(0.0f, (float)FlockSimulation::sizeY);
+        const Vector2 vel{random_ab(-1.0f, 1.0f), random_ab(-1.0f, 1.0f)};
+        return FlockSimulation::BoidInit{Vector2{x, y}, vel};
+    });
+}
+
+// Checksum after a fresh run of steps steps on threads threads
+static uint64_t runOn(unsigned threads, int boids, unsigned seed, int steps, float dt, int churn)
+{
+    Jobs::init(threads);
+    FlockSimulation::restart(boids, seed);
+    for (int s = 0; s < steps; ++s)
+    {
+        FlockSimulation::withIndex([&](auto &index) {
+            if (churn > 0)
+                churnFlock(index, churn);
+            FlockSimulation::step(index, dt);
+        });
+    }
+    return FlockSimulation::checksum();
+}
+
+// Seconds a fresh run of steps steps takes on the current pool
+static double timeRun(int boids, unsigned seed, int steps, float dt, int churn)
+{
+    FlockSimulation::restart(boids, seed);
+    const double start = FlockSimulation::seconds();
+    for (int s = 0; s < steps; ++s)
+    {
+        FlockSimulation::withIndex([&](auto &index) {
+            if (churn > 0)
+                churnFlock(index, churn);
+            FlockSimulation::step(index, dt);
+        });
+    }
+    return FlockSimulation::seconds() - start;
+}
+
+// The same run with the sort triggers as configured and with both off
+static void compareSort(int boids, unsigned seed, int steps, float dt, int churn)
+{
+    const double sorted = timeRun(boids, seed, steps, dt, churn);
+    const uint32_t sorts = FlockSimulation::boidSorts;
+    const uint32_t interval = FlockSimulation::sortInterval;
+    const float degrade = FlockSimulation::sortDegrade;
+    FlockSimulation::sortInterval = 0;
+    FlockSimulation::sortDegrade = 0.0f;
+    const double unsorted = timeRun(boids, seed, steps, dt, churn);
+    FlockSimulation::sortInterval = interval;
+    FlockSimulation::sortDegrade = degrade;
+
+    std::printf("sorted      %10.3f ms  (%.2f steps/s, %u sorts)\n", sorted * 1000.0, steps / sorted, sorts);
+    std::printf("unsorted    %10.3f ms  (%.2f steps/s)\n", unsorted * 1000.0, steps / unsorted);
+    std::printf("speedup     %10.2fx\n", unsorted / sorted);
+}
+
+// The parallel paths must not change the result: the configuration on 1 and
+// on threads threads, then again with the parallel step, which has to match
+// the serial step as well, and with parallel collisions on top
+static bool checkThreads(unsigned threads, int boids, unsigned seed, int steps, float dt, int churn)
+{
+    bool ok = true;
+    const auto check = [&](const char *mode, uint64_t expected) {
+        const uint64_t serial = runOn(1, boids, seed, steps, dt, churn);
+        const uint64_t parallel = runOn(threads, boids, seed, steps, dt, churn);
+        const bool same = serial == parallel && (expected == 0 || serial == expected);
+        std::printf("%-14s threads 1 %016" PRIx64 "  threads %u %016" PRIx64 "  %s\n",
+                    mode, serial, threads, parallel, same ? "ok" : "MISMATCH");
+        ok &= same;
+        return serial;
+    };
+
+    const bool parallelStep = FlockSimulation::parallelStep;
+    const bool parallelCollisions = FlockSimulation::parallelCollisions;
+    FlockSimulation::parallelCollisions = false;
+    FlockSimulation::parallelStep = false;
+    const uint64_t reference = check("serial step", 0);
+    FlockSimulation::parallelStep = true;
+    check("parallel step", reference);
+    // coloured contacts resolve in another order than the serial pass
+    FlockSimulation::parallelCollisions = true;
+    check("parallel all", 0);
+    FlockSimulation::parallelStep = parallelStep;
+    FlockSimulation::parallelCollisions = parallelCollisions;
+
+    Jobs::shutdown();
+    return ok;
+}
+
+// Vector kernels only sum in another order: counts must match exactly,
+// sums up to a relative tolerance
+static bool sameSums(const FlockKernels::Sums &a, const FlockKernels::Sums &b, float &worst)
+{
+    const auto close = [&worst](float u, float v) {
+        const float err = std::fabs(u - v) / std::max(1.0f, std::fabs(v));
+        worst = std::max(worst, err);
+        return err <= 1e-4f;
+    };
+    return a.countPAC == b.countPAC && a.countSEP == b.countSEP &&
+           close(a.sumVel.x, b.sumVel.x) && close(a.sumVel.y, b.sumVel.y) &&
+           close(a.sumPos.x, b.sumPos.x) && close(a.sumPos.y, b.sumPos.y) &&
+           close(a.sepAcc.x, b.sepAcc.x) && close(a.sepAcc.y, b.sepAcc.y);
+}
+
+// Every kernel the CPU supports against the scalar one on random lists
+static bool checkKernels(unsigned seed)
+{
+    const uint32_t count = 4096, lists = 20000, longest = 67;
+    const float pr = FlockSimulation::perceptionRadius, sr = FlockSimulation::separationRadius;
+    srand(seed);
+    std::vector<float> x(count), y(count), vx(count), vy(count);
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        // a small patch, so most candidates are within perception
+        x[k] = random_ab(0.0f, 3.0f * pr);
+        y[k] = random_ab(0.0f, 3.0f * pr);
+        vx[k] = random_ab(-1.0f, 1.0f);
+        vy[k] = random_ab(-1.0f, 1.0f);
+    }
+    const FlockKernels::Lanes lanes{x.data(), y.data(), vx.data(), vy.data()};
+
+    // Candidates may hold the boid itself and repeats, as the batches do
+    std::vector<uint32_t> owner(lists), offsets(lists + 1, 0), items;
+    for (uint32_t l = 0; l < lists; ++l)
+    {
+        owner[l] = (uint32_t)rand() % count;
+        const uint32_t n = (uint32_t)rand() % (longest + 1);
+        for (uint32_t k = 0; k < n; ++k)
+            items.push_back(k == 0 && l % 3 == 0 ? owner[l] : (uint32_t)rand() % count);
+        offsets[l + 1] = (uint32_t)items.size();
+    }
+
+    const FlockKernels::Isa selected = FlockKernels::isa;
+    std::vector<FlockKernels::Sums> reference(lists);
+    FlockKernels::select(FlockKernels::Isa::Scalar);
+    for (uint32_t l = 0; l < lists; ++l)
+        FlockKernels::accumulate(lanes, owner[l], items.data() + offsets[l], items.data() + offsets[l + 1],
+                                 pr * pr, sr * sr, reference[l]);
+
+    bool ok = true;
+    for (FlockKernels::Isa isa : {FlockKernels::Isa::SSE, FlockKernels::Isa::AVX2})
+    {
+        if ((int)isa > (int)FlockKernels::detect())
+        {
+            std::printf("%-8s not supported here\n", FlockKernels::name(isa));
+            continue;
+        }
+        FlockKernels::select(isa);
+        uint32_t bad = 0;
+        float worst = 0.0f;
+        for (uint32_t l = 0; l < lists; ++l)
+        {
+            FlockKernels::Sums sums;
+            FlockKernels::accumulate(lanes, owner[l], items.data() + offsets[l], items.data() + offsets[l + 1],
+                                     pr * pr, sr * sr, sums);
+            bad += sameSums(sums, reference[l], worst) ? 0 : 1;
+        }
+        std::printf("%-8s %u lists  worst relative error %.2e  %s\n", FlockKernels::name(isa), lists, worst,
+                    bad == 0 ? "ok" : "MISMATCH");
+        ok &= bad == 0;
+    }
+    FlockKernels::select(selected);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int boids = 20000;
+    int steps = 600;
+    unsigned seed = 1;
+    float dt = 1.0f / 60.0f;
+    int worldW = FlockSimulation::sizeX, worldH = FlockSimulation::sizeY;
+    unsigned threads = 1;
+    float renderZoom = 0.0f; // 0: no render timing
+    const char *tracePath = nullptr;
+    FlockSimulation::traceFrames = 10; // the last steps of a run, not 120 frames
+    int churn = 0;
+    unsigned checkThreadCount = 0; // 0: benchmark instead
+    bool checkKernelSums = false;
+    bool compareSorting = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "--boids=", 8) == 0)
+            boids = std::atoi(argv[i] + 8);
+        else if (std::strncmp(argv[i], "--steps=", 8) == 0)
+            steps = std::atoi(argv[i] + 8);
+        else if (std::strncmp(argv[i], "--seed=", 7) == 0)
+            seed = (unsigned)std::strtoul(argv[i] + 7, nullptr, 10);
+        else if (std::strncmp(argv[i], "--dt=", 5) == 0)
+            dt = (float)std::atof(argv[i] + 5);
+        else if (std::strncmp(argv[i], "--world=", 8) == 0)
+        {
+            if (std::sscanf(argv[i] + 8, "%dx%d", &worldW, &worldH) != 2 || worldW <= 0 || worldH <= 0)
+            {
+                std::cerr << "bad world size '" << (argv[i] + 8) << "', expected WxH\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strncmp(argv[i], "--index=", 8) == 0)
+        {
+            if (!FlockSimulation::selectIndex(argv[i] + 8))
+                std::cerr << "unknown index '" << (argv[i] + 8) << "', using quadtree\n";
+        }
+        else if (std::strcmp(argv[i], "--rebuild-index") == 0)
+            FlockSimulation::incrementalIndex = false;
+        else if (std::strcmp(argv[i], "--topological") == 0)
+            FlockSimulation::topological = true;
+        else if (std::strcmp(argv[i], "--periodic") == 0)
+            FlockSimulation::periodic = true;
+        else if (std::strcmp(argv[i], "--verlet") == 0)
+            FlockSimulation::verletLists = true;
+        else if (std::strncmp(argv[i], "--verlet-skin=", 14) == 0)
+            FlockSimulation::verletSkin = std::max(0.0f, (float)std::atof(argv[i] + 14));
+        else if (std::strcmp(argv[i], "--resync-collisions") == 0)
+            FlockSimulation::fusedStep = false;
+        else if (std::strncmp(argv[i], "--sort-interval=", 16) == 0)
+            FlockSimulation::sortInterval = (uint32_t)std::max(0, std::atoi(argv[i] + 16));
+        else if (std::strncmp(argv[i], "--sort-degrade=", 15) == 0)
+            FlockSimulation::sortDegrade = std::max(0.0f, (float)std::atof(argv[i] + 15));
+        else if (std::strncmp(argv[i], "--flock-kernel=", 15) == 0)
+        {
+            if (!FlockKernels::select(argv[i] + 15))
+                std::cerr << "unknown flock kernel '" << (argv[i] + 15) << "', using " << FlockKernels::name(FlockKernels::isa) << "\n";
+        }
+        else if (std::strcmp(argv[i], "--parallel-step") == 0)
+            FlockSimulation::parallelStep = true;
+        else if (std::strcmp(argv[i], "--parallel-collide") == 0)
+            FlockSimulation::parallelCollisions = true;
+        else if (std::strncmp(argv[i], "--render-zoom=", 14) == 0)
+            renderZoom = (float)std::atof(argv[i] + 14);
+        else if (std::strncmp(argv[i], "--churn=", 8) == 0)
+            churn = std::max(0, std::atoi(argv[i] + 8));
+        else if (std::strncmp(argv[i], "--trace=", 8) == 0)
+            tracePath = argv[i] + 8;
+        else if (std::strncmp(argv[i], "--trace-frames=", 15) == 0)
+            FlockSimulation::traceFrames = std::max(1, std::atoi(argv[i] + 15));
+        else if (std::strcmp(argv[i], "--compare-sort") == 0)
+            compareSorting = true;
+        else if (std::strcmp(argv[i], "--check-kernels") == 0)
+            checkKernelSums = true;
+        else if (std::strncmp(argv[i], "--check-threads=", 16) == 0)
+            checkThreadCount = (unsigned)std::max(2, std::atoi(argv[i] + 16));
+        else if (std::strncmp(argv[i], "--threads=", 10) == 0)
+            threads = (unsigned)std::max(1, std::atoi(argv[i] + 10));
+        else
+        {
+            std::cerr << "unknown argument '" << argv[i] << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (checkKernelSums)
+        return checkKernels(seed) ? EXIT_SUCCESS : EXIT_FAILURE;
+    FlockSimulation::resizeWorld(worldW, worldH);
+    if (checkThreadCount > 0)
+        return checkThreads(checkThreadCount, boids, seed, steps, dt, churn) ? EXIT_SUCCESS : EXIT_FAILURE;
+    Jobs::init(threads);
+    if (compareSorting)
+    {
+        std::printf("boids %d  steps %d  seed %u  world %dx%d  threads %u  kernel %s\n",
+                    boids, steps, seed, worldW, worldH, threads, FlockKernels::name(FlockKernels::isa));
+        compareSort(boids, seed, steps, dt, churn);
+        Jobs::shutdown();
+        return EXIT_SUCCESS;
+    }
+
+    const double setupStart = FlockSimulation::seconds();
+    FlockSimulation::prepare(boids, seed);
+    const double setup = FlockSimulation::seconds() - setupStart;
+
+    Camera2D camera = {0};
+    camera.offset = Vector2{1000.0f, 750.0f};
+    camera.target = Vector2{worldW * 0.5f, worldH * 0.5f};
+    camera.zoom = renderZoom;
+    const Rectangle view = CameraSystem::visibleWorldRect(camera, 2000.0f, 1500.0f);
+    const BoidRenderer::Lod lod = BoidRenderer::pick(FlockSimulation::ballRadius, renderZoom);
+    double render = 0.0;
+    double traceWrite = 0.0; // writing the trace file, kept out of the total
+    double churnTime = 0.0;
+    size_t drawn = 0;
+
+    FlockSimulation::phaseTimes = FlockSimulation::PhaseTimes();
+    const double start = FlockSimulation::seconds();
+    for (int s = 0; s < steps; ++s)
+    {
+        if (tracePath && s == std::max(0, steps - FlockSimulation::traceFrames))
+            Trace::capture(tracePath, std::min(steps, FlockSimulation::traceFrames));
+        Trace::beginFrame();
+        FlockSimulation::withIndex([&](auto &index) {
+            if (churn > 0)
+            {
+                const double c0 = FlockSimulation::seconds();
+                churnFlock(index, churn);
+                churnTime += FlockSimulation::seconds() - c0;
+            }
+            FlockSimulation::step(index, dt);
+            if (renderZoom <= 0.0f)
+                return;
+            const double r0 = FlockSimulation::seconds();
+            std::vector<uint32_t> &visible = FlockSimulation::visible;
+            FlockSimulation::cullBoids(index, view, visible);
+            FlockSimulation::drawPos.resize(visible.size());
+            FlockSimulation::drawDir.resize(visible.size());
+            for (size_t k = 0; k < visible.size(); ++k)
+            {
+                const uint32_t i = visible[k];
+                FlockSimulation::drawPos[k] = Vector2{FlockSimulation::boids.x[i], FlockSimulation::boids.y[i]};
+                FlockSimulation::drawDir[k] = vsafe_normalize(Vector2{FlockSimulation::boids.vx[i], FlockSimulation::boids.vy[i]});
+            }
+            BoidRenderer::build(lod, FlockSimulation::drawPos.data(), FlockSimulation::drawDir.data(), visible.size(),
+                                FlockSimulation::ballRadius, renderZoom, BoidRenderer::vertices);
+            render += FlockSimulation::seconds() - r0;
+            drawn += visible.size();
+        });
+        const double w0 = FlockSimulation::seconds();
+        Trace::endFrame();
+        traceWrite += FlockSimulation::seconds() - w0;
+    }
+    const double total = FlockSimulation::seconds() - start - render - traceWrite;
+
+    const FlockSimulation::PhaseTimes &t = FlockSimulation::phaseTimes;
+    const double perStep = 1000.0 / std::max(1, steps);
+    std::printf("boids %d  steps %d  seed %u  world %dx%d  threads %u  kernel %s\n",
+                boids, steps, seed, worldW, worldH, threads, FlockKernels::name(FlockKernels::isa));
+    std::printf("setup       %10.3f ms\n", setup * 1000.0);
+    std::printf("total       %10.3f ms  (%.1f steps/s)\n", total * 1000.0, total > 0.0 ? steps / total : 0.0);
+    std::printf("index       %10.3f ms/step\n", t.index * perStep);
+    std::printf("queries     %10.3f ms/step\n", t.queries * perStep);
+    std::printf("behavior    %10.3f ms/step\n", t.behavior * perStep);
+    std::printf("collisions  %10.3f ms/step\n", t.collisions * perStep);
+    std::printf("sort        %10.3f ms/step  (%u sorts)\n", t.sort * perStep, FlockSimulation::boidSorts);
+    if (churn > 0)
+        std::printf("churn       %10.3f ms/step  (%d boids in and out per step)\n", churnTime * perStep, churn);
+    if (FlockSimulation::verletLists)
+        std::printf("verlet      %10u list builds\n", FlockSimulation::verletBuilds);
+    if (renderZoom > 0.0f)
+        std::printf("render cpu  %10.3f ms/step  (%s lod, %zu boids/step)\n", render * perStep,
+                    BoidRenderer::name(lod), drawn / (size_t)std::max(1, steps));
+    std::printf("checksum    %016" PRIx64 "\n", FlockSimulation::checksum());
+
+    Jobs::shutdown();
+    return EXIT_SUCCESS;
+}
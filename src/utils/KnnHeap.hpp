@@ -0,0 +1,65 @@
+// KnnHeap.hpp
+#pragma once
+#include "raylib.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+// Fixed-capacity max-heap of the k closest elements offered so far, kept in
+// the caller's vector so repeated queries do not allocate. Distances are
+// recomputed from the store's positions instead of being stored.
+template <typename Store>
+struct KnnHeap
+{
+    const Store &store;
+    Vector2 point;
+    size_t k;
+    std::vector<uint32_t> &items;
+
+    KnnHeap(const Store &s, Vector2 p, size_t count, std::vector<uint32_t> &out)
+        : store(s), point(p), k(count), items(out)
+    {
+        items.clear();
+    }
+
+    float dist2(uint32_t e) const
+    {
+        const float dx = store.x[e] - point.x;
+        const float dy = store.y[e] - point.y;
+        return dx * dx + dy * dy;
+    }
+
+    bool closer(uint32_t a, uint32_t b) const { return dist2(a) < dist2(b); }
+
+    bool full() const { return items.size() >= k; }
+
+    // Squared distance a candidate has to beat; infinite until k are kept
+    float worst() const
+    {
+        return full() ? dist2(items.front()) : std::numeric_limits<float>::infinity();
+    }
+
+    void offer(uint32_t e)
+    {
+        if (k == 0) return;
+        const auto cmp = [this](uint32_t a, uint32_t b) { return closer(a, b); };
+        if (!full())
+        {
+            items.push_back(e);
+            std::push_heap(items.begin(), items.end(), cmp);
+        }
+        else if (dist2(e) < worst())
+        {
+            std::pop_heap(items.begin(), items.end(), cmp);
+            items.back() = e;
+            std::push_heap(items.begin(), items.end(), cmp);
+        }
+    }
+
+    // Leaves the result ordered nearest first
+    void finish()
+    {
+        std::sort_heap(items.begin(), items.end(), [this](uint32_t a, uint32_t b) { return closer(a, b); });
+    }
+};
@@ -0,0 +1,331 @@
+// LinearQuadTree.hpp
+#pragma once
+#include "raylib.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include "QuadTree.hpp"
+#include "dorMath.hpp"
+#include "QueryBatch.hpp"
+
+// Pointerless quadtree: elements are kept in one flat array sorted by the
+// Morton (Z-order) code of their position. Every quadtree cell maps to a
+// contiguous code range, so the tree is implicit and a rebuild is an
+// encode + radix sort. Same interface as QuadTree<Store>.
+template <typename Store>
+class LinearQuadTree
+{
+private:
+    static constexpr int kAxisBits = 16; // 16 bits per axis -> 32-bit codes
+
+    struct Entry
+    {
+        uint32_t code;
+        uint32_t element;
+    };
+
+    const Store *store_;
+    bool debug_ = true;
+    int capacity_;
+    Vector2 center_;
+    float width_, height_;
+    int depth_;
+    int maxLevel_;
+
+    std::vector<Entry> entries_; // sorted by code
+    std::vector<Entry> scratch_; // radix sort ping-pong buffer
+
+    uint32_t encode(float x, float y) const
+    {
+        return morton_encode(x, y, Rectangle{center_.x - width_ * 0.5f, center_.y - height_ * 0.5f, width_, height_});
+    }
+
+    static bool rectIntersectsCell(const Rectangle& r, const Vector2& c, float w, float h)
+    {
+        return !(r.x > c.x + w * 0.5f ||
+                 r.x + r.width < c.x - w * 0.5f ||
+                 r.y > c.y + h * 0.5f ||
+                 r.y + r.height < c.y - h * 0.5f);
+    }
+
+    static bool rectCoversCell(const Rectangle& r, const Vector2& c, float w, float h)
+    {
+        return r.x <= c.x - w * 0.5f && r.x + r.width >= c.x + w * 0.5f &&
+               r.y <= c.y - h * 0.5f && r.y + r.height >= c.y + h * 0.5f;
+    }
+
+    // [lo, hi) index range of the entries whose code starts with prefix at level
+    void cellRange(uint32_t prefix, int level, size_t from, size_t to, size_t &lo, size_t &hi) const
+    {
+        const int shift = 2 * (kAxisBits - level);
+        const uint64_t first = (uint64_t)prefix << shift;
+        const uint64_t last  = ((uint64_t)prefix + 1) << shift;
+        const auto cmp = [](const Entry &e, uint64_t c) { return (uint64_t)e.code < c; };
+        lo = std::lower_bound(entries_.begin() + from, entries_.begin() + to, first, cmp) - entries_.begin();
+        hi = std::lower_bound(entries_.begin() + lo, entries_.begin() + to, last, cmp) - entries_.begin();
+    }
+
+    void queryCell(uint32_t prefix, int level, const Vector2 &c, float w, float h,
+                   size_t lo, size_t hi, const Rectangle &region, std::vector<uint32_t> &found) const
+    {
+        if (lo == hi || !rectIntersectsCell(region, c, w, h)) return;
+
+        // Leaf-sized or fully covered cells are emitted as one contiguous range
+        if (hi - lo <= (size_t)capacity_ || level >= maxLevel_ || rectCoversCell(region, c, w, h))
+        {
+            for (size_t i = lo; i < hi; ++i) found.push_back(entries_[i].element);
+            return;
+        }
+
+        const float hw = w * 0.5f, hh = h * 0.5f;
+        for (uint32_t q = 0; q < 4; ++q)
+        {
+            const uint32_t child = (prefix << 2) | q;
+            const Vector2 cc{c.x + ((q & 1) ? hw : -hw) * 0.5f, c.y + ((q & 2) ? hh : -hh) * 0.5f};
+            size_t clo, chi;
+            cellRange(child, level + 1, lo, hi, clo, chi);
+            queryCell(child, level + 1, cc, hw, hh, clo, chi, region, found);
+        }
+    }
+
+    template <typename Fn>
+    void radiusCell(uint32_t prefix, int level, const Vector2 &c, float w, float h,
+                    size_t lo, size_t hi, const Vector2 &center, float r2, Fn &fn) const
+    {
+        if (lo == hi) return;
+        if (cellDist2(center, c, w, h) > r2) return;
+
+        if (hi - lo <= (size_t)capacity_ || level >= maxLevel_)
+        {
+            for (size_t i = lo; i < hi; ++i)
+            {
+                const uint32_t e = entries_[i].element;
+                const float ex = store_->x[e] - center.x;
+                const float ey = store_->y[e] - center.y;
+                if (ex * ex + ey * ey <= r2) fn(e);
+            }
+            return;
+        }
+
+        const float hw = w * 0.5f, hh = h * 0.5f;
+        for (uint32_t q = 0; q < 4; ++q)
+        {
+            const uint32_t child = (prefix << 2) | q;
+            const Vector2 cc{c.x + ((q & 1) ? hw : -hw) * 0.5f, c.y + ((q & 2) ? hh : -hh) * 0.5f};
+            size_t clo, chi;
+            cellRange(child, level + 1, lo, hi, clo, chi);
+            radiusCell(child, level + 1, cc, hw, hh, clo, chi, center, r2, fn);
+        }
+    }
+
+    // Packet traversal: mask holds the queries still overlapping this cell
+    void batchCell(uint32_t prefix, int level, const Vector2 &c, float w, float h,
+                   size_t lo, size_t hi, const Rectangle *rects, uint32_t mask,
+                   std::vector<uint32_t> *lists) const
+    {
+        if (lo == hi) return;
+        uint32_t live = 0;
+        for (uint32_t i = 0; (mask >> i) != 0; ++i)
+            if (((mask >> i) & 1u) && rectIntersectsCell(rects[i], c, w, h))
+                live |= 1u << i;
+        if (live == 0) return;
+
+        if (hi - lo <= (size_t)capacity_ || level >= maxLevel_)
+        {
+            for (size_t e = lo; e < hi; ++e)
+            {
+                const uint32_t el = entries_[e].element;
+                for (uint32_t i = 0; (live >> i) != 0; ++i)
+                    if (((live >> i) & 1u) && pointInRect(rects[i], store_->x[el], store_->y[el]))
+                        lists[i].push_back(el);
+            }
+            return;
+        }
+
+        const float hw = w * 0.5f, hh = h * 0.5f;
+        for (uint32_t q = 0; q < 4; ++q)
+        {
+            const uint32_t child = (prefix << 2) | q;
+            const Vector2 cc{c.x + ((q & 1) ? hw : -hw) * 0.5f, c.y + ((q & 2) ? hh : -hh) * 0.5f};
+            size_t clo, chi;
+            cellRange(child, level + 1, lo, hi, clo, chi);
+            batchCell(child, level + 1, cc, hw, hh, clo, chi, rects, live, lists);
+        }
+    }
+
+    static float cellDist2(const Vector2 &p, const Vector2 &c, float w, float h)
+    {
+        const float dx = std::max(std::fabs(p.x - c.x) - w * 0.5f, 0.0f);
+        const float dy = std::max(std::fabs(p.y - c.y) - h * 0.5f, 0.0f);
+        return dx * dx + dy * dy;
+    }
+
+    void knnCell(uint32_t prefix, int level, const Vector2 &c, float w, float h,
+                 size_t lo, size_t hi, KnnHeap<Store> &heap) const
+    {
+        if (hi - lo <= (size_t)capacity_ || level >= maxLevel_)
+        {
+            for (size_t i = lo; i < hi; ++i) heap.offer(entries_[i].element);
+            return;
+        }
+
+        const float hw = w * 0.5f, hh = h * 0.5f;
+        Vector2 cc[4];
+        size_t clo[4], chi[4];
+        float d[4];
+        uint32_t order[4] = {0, 1, 2, 3};
+        for (uint32_t q = 0; q < 4; ++q)
+        {
+            cc[q] = Vector2{c.x + ((q & 1) ? hw : -hw) * 0.5f, c.y + ((q & 2) ? hh : -hh) * 0.5f};
+            cellRange((prefix << 2) | q, level + 1, lo, hi, clo[q], chi[q]);
+            d[q] = cellDist2(heap.point, cc[q], hw, hh);
+        }
+        std::sort(order, order + 4, [&](uint32_t a, uint32_t b) { return d[a] < d[b]; });
+
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            const uint32_t q = order[i];
+            if (d[q] > heap.worst()) break;
+            if (clo[q] == chi[q]) continue;
+            knnCell((prefix << 2) | q, level + 1, cc[q], hw, hh, clo[q], chi[q], heap);
+        }
+    }
+
+    // view == nullptr draws every cell
+    void drawCell(uint32_t prefix, int level, const Vector2 &c, float w, float h, size_t lo, size_t hi,
+                  const Rectangle *view) const
+    {
+        if (view && !rectIntersectsCell(*view, c, w, h)) return;
+        DrawRectangleLines((c.x - w * 0.5f), (c.y - h * 0.5f), (w), (h), ORANGE);
+        if (hi - lo <= (size_t)capacity_ || level >= maxLevel_) return;
+
+        const float hw = w * 0.5f, hh = h * 0.5f;
+        for (uint32_t q = 0; q < 4; ++q)
+        {
+            const uint32_t child = (prefix << 2) | q;
+            const Vector2 cc{c.x + ((q & 1) ? hw : -hw) * 0.5f, c.y + ((q & 2) ? hh : -hh) * 0.5f};
+            size_t clo, chi;
+            cellRange(child, level + 1, lo, hi, clo, chi);
+            drawCell(child, level + 1, cc, hw, hh, clo, chi, view);
+        }
+    }
+
+    // LSD radix sort on the 32-bit codes, 8 bits per pass
+    void radixSort()
+    {
+        scratch_.resize(entries_.size());
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            size_t counts[257] = {0};
+            for (const Entry &e : entries_) ++counts[((e.code >> shift) & 0xFFu) + 1];
+            for (int b = 0; b < 256; ++b) counts[b + 1] += counts[b];
+            for (const Entry &e : entries_) scratch_[counts[(e.code >> shift) & 0xFFu]++] = e;
+            entries_.swap(scratch_);
+        }
+    }
+
+    bool eraseEntry(uint32_t element, uint32_t code)
+    {
+        auto it = std::lower_bound(entries_.begin(), entries_.end(), code,
+                                   [](const Entry &e, uint32_t c) { return e.code < c; });
+        for (; it != entries_.end() && it->code == code; ++it)
+        {
+            if (it->element != element) continue;
+            entries_.erase(it);
+            return true;
+        }
+        return false;
+    }
+
+public:
+    LinearQuadTree(const Store &store, const Vector2 &center, float width, float height, int capacity, int depth)
+        : store_(&store), capacity_(capacity), center_(center), width_(width), height_(height),
+          depth_(depth), maxLevel_(std::min(max_depth - depth, (int)kAxisBits)) {}
+
+    // Sorted insert, O(n) shift; prefer rebuild() for bulk loads
+    void insert(uint32_t element)
+    {
+        const Entry e{encode(store_->x[element], store_->y[element]), element};
+        auto it = std::upper_bound(entries_.begin(), entries_.end(), e.code,
+                                   [](uint32_t c, const Entry &x) { return c < x.code; });
+        entries_.insert(it, e);
+    }
+
+    // Removes an element that has not moved since it was inserted or last refit
+    bool remove(uint32_t element)
+    {
+        return eraseEntry(element, encode(store_->x[element], store_->y[element]));
+    }
+
+    void update(uint32_t element, Vector2 oldPos)
+    {
+        eraseEntry(element, encode(oldPos.x, oldPos.y));
+        insert(element);
+    }
+
+    // Re-encode in place; the sort is skipped when no element changed order
+    void refit()
+    {
+        for (Entry &e : entries_) e.code = encode(store_->x[e.element], store_->y[e.element]);
+        if (!std::is_sorted(entries_.begin(), entries_.end(),
+                            [](const Entry &a, const Entry &b) { return a.code < b.code; }))
+            radixSort();
+    }
+
+    void setDebugMode(bool d) { debug_ = d; }
+
+    // Rectangle query (broadphase); returns handles potentially overlapping region.
+    void rectQuery(const Rectangle &region, std::vector<uint32_t> &found) const
+    {
+        queryCell(0, 0, center_, width_, height_, 0, entries_.size(), region, found);
+    }
+
+    // Answers many rectangle queries at once in Z-order, neighbouring queries
+    // sharing a traversal; results are exact (position inside the rectangle)
+    void rectQueryBatch(const std::vector<Rectangle> &queries, QueryBatch &out) const
+    {
+        const Rectangle bounds{center_.x - width_ * 0.5f, center_.y - height_ * 0.5f, width_, height_};
+        runQueryBatch(queries, bounds, out, [&](const Rectangle *rects, uint32_t n, std::vector<uint32_t> *lists) {
+            batchCell(0, 0, center_, width_, height_, 0, entries_.size(), rects, (1u << n) - 1, lists);
+        });
+    }
+
+    // Calls fn(uint32_t) for every element within r of center, without collecting
+    template <typename Fn>
+    void forEachInRadius(Vector2 center, float r, Fn &&fn) const
+    {
+        radiusCell(0, 0, center_, width_, height_, 0, entries_.size(), center, r * r, fn);
+    }
+
+    // The k elements closest to point, nearest first; out doubles as the bounded heap
+    void knn(Vector2 point, size_t k, std::vector<uint32_t> &out) const
+    {
+        KnnHeap<Store> heap(*store_, point, k, out);
+        if (k > 0 && !entries_.empty())
+            knnCell(0, 0, center_, width_, height_, 0, entries_.size(), heap);
+        heap.finish();
+    }
+
+    void drawDebug() const
+    {
+        if (!debug_) return;
+        drawCell(0, 0, center_, width_, height_, 0, entries_.size(), nullptr);
+    }
+
+    // Only descends into cells overlapping view (world space)
+    void drawDebug(const Rectangle &view) const
+    {
+        if (!debug_) return;
+        drawCell(0, 0, center_, width_, height_, 0, entries_.size(), &view);
+    }
+
+    // Re-encodes every handle in the store
+    void rebuild()
+    {
+        const uint32_t count = store_->size();
+        entries_.resize(count);
+        for (uint32_t e = 0; e < count; ++e) entries_[e] = Entry{encode(store_->x[e], store_->y[e]), e};
+        radixSort();
+    }
+};
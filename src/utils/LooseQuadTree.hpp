@@ -0,0 +1,490 @@
+// LooseQuadTree.hpp
+#pragma once
+#include "raylib.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include "QuadTree.hpp"
+#include "KnnHeap.hpp"
+#include "QueryBatch.hpp"
+
+// Loose quadtree over element extents (Store::bounds(i)). Every node's loose
+// box is its tight box grown by half its size on each side; an element lives
+// in exactly one node, the deepest one on its center's path whose loose box
+// still holds its bounds. Nothing is stored twice, so queries return unique
+// results and rectangle queries can test the real extents.
+// Same interface as QuadTree<Store>.
+template <typename Store>
+class LooseQuadTree
+{
+private:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    struct Node
+    {
+        Vector2 center;
+        float width, height; // tight size; the loose box is twice as large
+        int depth;
+        uint32_t parent;
+        uint32_t firstChild; // 4 children stored back to back (TL, TR, BL, BR), kNone for leaves
+        uint32_t firstLink;  // elements stored at this node (internal nodes too)
+        uint32_t count;
+    };
+
+    struct Link
+    {
+        uint32_t element;
+        uint32_t next;
+    };
+
+    const Store *store_;
+    bool debug_ = true;
+    int capacity_;
+    Vector2 center_;
+    float width_, height_;
+    int depth_;
+
+    std::vector<Node> nodes_; // nodes_[0] is the root
+    std::vector<Link> links_;
+    std::vector<uint32_t> freeBlocks_;
+    uint32_t freeLink_ = kNone;
+    std::vector<uint32_t> moved_; // refit scratch
+
+    static bool rectsOverlap(const Rectangle &a, const Rectangle &b)
+    {
+        return !(a.x > b.x + b.width || a.x + a.width < b.x ||
+                 a.y > b.y + b.height || a.y + a.height < b.y);
+    }
+
+    static Rectangle looseRect(const Node &node)
+    {
+        return Rectangle{node.center.x - node.width, node.center.y - node.height,
+                         2.0f * node.width, 2.0f * node.height};
+    }
+
+    static float nodeDist2(const Vector2 &c, const Node &node)
+    {
+        const float dx = std::max(std::fabs(c.x - node.center.x) - node.width * 0.5f, 0.0f);
+        const float dy = std::max(std::fabs(c.y - node.center.y) - node.height * 0.5f, 0.0f);
+        return dx * dx + dy * dy;
+    }
+
+    Vector2 homePosition(float x, float y) const
+    {
+        return Vector2{
+            std::min(std::max(x, center_.x - width_ * 0.5f), center_.x + width_ * 0.5f),
+            std::min(std::max(y, center_.y - height_ * 0.5f), center_.y + height_ * 0.5f)};
+    }
+
+    static uint32_t childFor(const Node &node, const Vector2 &p)
+    {
+        return (p.x >= node.center.x ? 1u : 0u) | (p.y >= node.center.y ? 2u : 0u);
+    }
+
+    // Same half-open rule as childFor, so "on n's path" and "inside n" agree
+    bool onPath(const Node &node, const Vector2 &p) const
+    {
+        const float right  = node.center.x + node.width * 0.5f;
+        const float bottom = node.center.y + node.height * 0.5f;
+        return p.x >= node.center.x - node.width * 0.5f &&
+               p.y >= node.center.y - node.height * 0.5f &&
+               (p.x < right  || right  >= center_.x + width_ * 0.5f) &&
+               (p.y < bottom || bottom >= center_.y + height_ * 0.5f);
+    }
+
+    // The root takes anything; other nodes need the extent inside their loose
+    // box and the center inside the world, so point queries can prune on tight boxes
+    bool fits(uint32_t n, uint32_t e) const
+    {
+        if (n == 0) return true;
+        const Vector2 home = homePosition(store_->x[e], store_->y[e]);
+        if (home.x != store_->x[e] || home.y != store_->y[e]) return false;
+        const Rectangle loose = looseRect(nodes_[n]);
+        const Rectangle b = store_->bounds(e);
+        return b.x >= loose.x && b.y >= loose.y &&
+               b.x + b.width <= loose.x + loose.width && b.y + b.height <= loose.y + loose.height;
+    }
+
+    uint32_t makeNode(const Vector2 &center, float width, float height, int depth, uint32_t parent)
+    {
+        nodes_.push_back(Node{center, width, height, depth, parent, kNone, kNone, 0});
+        return (uint32_t)(nodes_.size() - 1);
+    }
+
+    uint32_t allocLink(uint32_t element)
+    {
+        if (freeLink_ != kNone)
+        {
+            const uint32_t link = freeLink_;
+            freeLink_ = links_[link].next;
+            links_[link] = Link{element, kNone};
+            return link;
+        }
+        links_.push_back(Link{element, kNone});
+        return (uint32_t)(links_.size() - 1);
+    }
+
+    void freeLink(uint32_t link)
+    {
+        links_[link].next = freeLink_;
+        freeLink_ = link;
+    }
+
+    void pushLink(uint32_t n, uint32_t link)
+    {
+        links_[link].next = nodes_[n].firstLink;
+        nodes_[n].firstLink = link;
+        ++nodes_[n].count;
+    }
+
+    bool overCapacity(uint32_t n) const
+    {
+        const int depth = nodes_[n].depth;
+        return depth < max_depth && nodes_[n].count > (uint32_t)capacity_;
+    }
+
+    void subdivide(uint32_t n)
+    {
+        if (nodes_[n].firstChild != kNone) return;
+
+        const Node parent = nodes_[n];
+        const float hw = parent.width * 0.5f;
+        const float hh = parent.height * 0.5f;
+        const Vector2 c = parent.center;
+        const Vector2 centers[4] = {
+            Vector2{c.x - hw * 0.5f, c.y - hh * 0.5f},
+            Vector2{c.x + hw * 0.5f, c.y - hh * 0.5f},
+            Vector2{c.x - hw * 0.5f, c.y + hh * 0.5f},
+            Vector2{c.x + hw * 0.5f, c.y + hh * 0.5f}};
+
+        uint32_t first;
+        if (!freeBlocks_.empty())
+        {
+            first = freeBlocks_.back();
+            freeBlocks_.pop_back();
+            for (uint32_t i = 0; i < 4; ++i)
+                nodes_[first + i] = Node{centers[i], hw, hh, parent.depth + 1, n, kNone, kNone, 0};
+        }
+        else
+        {
+            first = makeNode(centers[0], hw, hh, parent.depth + 1, n);
+            for (uint32_t i = 1; i < 4; ++i)
+                makeNode(centers[i], hw, hh, parent.depth + 1, n);
+        }
+
+        nodes_[n].firstChild = first;
+        nodes_[n].firstLink = kNone;
+        nodes_[n].count = 0;
+
+        // Elements whose extent fits a child move down, the rest stay here
+        uint32_t link = parent.firstLink;
+        while (link != kNone)
+        {
+            const uint32_t next = links_[link].next;
+            const uint32_t e = links_[link].element;
+            const uint32_t ch = first + childFor(parent, homePosition(store_->x[e], store_->y[e]));
+            pushLink(fits(ch, e) ? ch : n, link);
+            link = next;
+        }
+
+        for (uint32_t i = 0; i < 4; ++i)
+            if (overCapacity(first + i))
+                subdivide(first + i);
+    }
+
+    void insertAt(uint32_t n, uint32_t element)
+    {
+        const Vector2 p = homePosition(store_->x[element], store_->y[element]);
+        for (;;)
+        {
+            const uint32_t first = nodes_[n].firstChild;
+            if (first == kNone) break;
+            const uint32_t ch = first + childFor(nodes_[n], p);
+            if (!fits(ch, element)) break;
+            n = ch;
+        }
+
+        pushLink(n, allocLink(element));
+        if (nodes_[n].firstChild == kNone && overCapacity(n))
+            subdivide(n);
+    }
+
+    // Pull n's four leaf children back into n when everything fits one node
+    bool tryMerge(uint32_t n)
+    {
+        const uint32_t first = nodes_[n].firstChild;
+        if (first == kNone) return false;
+
+        uint32_t total = nodes_[n].count;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            if (nodes_[first + i].firstChild != kNone) return false;
+            total += nodes_[first + i].count;
+        }
+        if (total > (uint32_t)capacity_) return false;
+
+        nodes_[n].firstChild = kNone;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            uint32_t link = nodes_[first + i].firstLink;
+            while (link != kNone)
+            {
+                const uint32_t next = links_[link].next;
+                pushLink(n, link);
+                link = next;
+            }
+        }
+        freeBlocks_.push_back(first);
+        return true;
+    }
+
+    bool unlinkFrom(uint32_t n, uint32_t element)
+    {
+        uint32_t *prev = &nodes_[n].firstLink;
+        while (*prev != kNone)
+        {
+            const uint32_t link = *prev;
+            if (links_[link].element == element)
+            {
+                *prev = links_[link].next;
+                freeLink(link);
+                --nodes_[n].count;
+                return true;
+            }
+            prev = &links_[link].next;
+        }
+        return false;
+    }
+
+    // Follows the center's path; the element sits on it unless it moved unseen
+    bool removeAt(uint32_t n, uint32_t element, const Vector2 &p)
+    {
+        const uint32_t first = nodes_[n].firstChild;
+        const bool removed = unlinkFrom(n, element) ||
+                             (first != kNone && removeAt(first + childFor(nodes_[n], p), element, p));
+        if (removed) tryMerge(n);
+        return removed;
+    }
+
+    void refitAt(uint32_t n)
+    {
+        const uint32_t first = nodes_[n].firstChild;
+        uint32_t *prev = &nodes_[n].firstLink;
+        while (*prev != kNone)
+        {
+            const uint32_t link = *prev;
+            const uint32_t e = links_[link].element;
+            const Vector2 p = homePosition(store_->x[e], store_->y[e]);
+
+            // stays if still on this node's path, still fits, and cannot sink lower
+            const bool stays = (n == 0 || (onPath(nodes_[n], p) && fits(n, e))) &&
+                               (first == kNone || !fits(first + childFor(nodes_[n], p), e));
+            if (stays)
+            {
+                prev = &links_[link].next;
+                continue;
+            }
+            *prev = links_[link].next;
+            freeLink(link);
+            --nodes_[n].count;
+            moved_.push_back(e);
+        }
+
+        if (first != kNone)
+        {
+            for (uint32_t i = 0; i < 4; ++i)
+                refitAt(first + i);
+            tryMerge(n);
+        }
+    }
+
+    void queryAt(uint32_t n, const Rectangle &region, std::vector<uint32_t> &found) const
+    {
+        const Node &node = nodes_[n];
+        if (n != 0 && !rectsOverlap(region, looseRect(node))) return;
+
+        for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+            if (rectsOverlap(region, store_->bounds(links_[l].element)))
+                found.push_back(links_[l].element);
+
+        if (node.firstChild != kNone)
+            for (uint32_t i = 0; i < 4; ++i)
+                queryAt(node.firstChild + i, region, found);
+    }
+
+    void batchAt(uint32_t n, const Rectangle *rects, uint32_t mask, std::vector<uint32_t> *lists) const
+    {
+        const Node &node = nodes_[n];
+        uint32_t live = mask;
+        if (n != 0)
+        {
+            const Rectangle loose = looseRect(node);
+            live = 0;
+            for (uint32_t i = 0; (mask >> i) != 0; ++i)
+                if (((mask >> i) & 1u) && rectsOverlap(rects[i], loose))
+                    live |= 1u << i;
+            if (live == 0) return;
+        }
+
+        for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+        {
+            const uint32_t e = links_[l].element;
+            for (uint32_t i = 0; (live >> i) != 0; ++i)
+                if (((live >> i) & 1u) && rectsOverlap(rects[i], store_->bounds(e)))
+                    lists[i].push_back(e);
+        }
+
+        if (node.firstChild != kNone)
+            for (uint32_t i = 0; i < 4; ++i)
+                batchAt(node.firstChild + i, rects, live, lists);
+    }
+
+    // Centers of a node's elements lie in its tight box, so point queries prune on that
+    template <typename Fn>
+    void radiusAt(uint32_t n, const Vector2 &c, float r2, Fn &fn) const
+    {
+        const Node &node = nodes_[n];
+        if (n != 0 && nodeDist2(c, node) > r2) return;
+
+        for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+        {
+            const uint32_t e = links_[l].element;
+            const float dx = store_->x[e] - c.x;
+            const float dy = store_->y[e] - c.y;
+            if (dx * dx + dy * dy <= r2) fn(e);
+        }
+
+        if (node.firstChild != kNone)
+            for (uint32_t i = 0; i < 4; ++i)
+                radiusAt(node.firstChild + i, c, r2, fn);
+    }
+
+    void knnAt(uint32_t n, KnnHeap<Store> &heap) const
+    {
+        const Node &node = nodes_[n];
+        for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+            heap.offer(links_[l].element);
+        if (node.firstChild == kNone) return;
+
+        float d[4];
+        uint32_t order[4] = {0, 1, 2, 3};
+        for (uint32_t i = 0; i < 4; ++i) d[i] = nodeDist2(heap.point, nodes_[node.firstChild + i]);
+        std::sort(order, order + 4, [&](uint32_t a, uint32_t b) { return d[a] < d[b]; });
+
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            if (d[order[i]] > heap.worst()) break;
+            knnAt(node.firstChild + order[i], heap);
+        }
+    }
+
+    // view == nullptr draws the whole tree; tight boxes nest, so they prune
+    void drawAt(uint32_t n, const Rectangle *view) const
+    {
+        const Node &node = nodes_[n];
+        if (view && !rectsOverlap(*view, Rectangle{node.center.x - node.width * 0.5f, node.center.y - node.height * 0.5f,
+                                                   node.width, node.height}))
+            return;
+        DrawRectangleLines(
+            (node.center.x - node.width * 0.5f),
+            (node.center.y - node.height * 0.5f),
+            (node.width),
+            (node.height),
+            ORANGE);
+        if (node.firstChild != kNone)
+            for (uint32_t i = 0; i < 4; ++i) drawAt(node.firstChild + i, view);
+    }
+
+    void reset()
+    {
+        nodes_.clear();
+        links_.clear();
+        freeBlocks_.clear();
+        freeLink_ = kNone;
+        makeNode(center_, width_, height_, depth_, kNone);
+    }
+
+public:
+    LooseQuadTree(const Store &store, const Vector2 &center, float width, float height, int capacity, int depth)
+        : store_(&store), capacity_(capacity), center_(center), width_(width), height_(height),
+          depth_(depth)
+    {
+        reset();
+    }
+
+    void insert(uint32_t element) { insertAt(0, element); }
+
+    // Removes an element that has not moved since it was inserted or last refit
+    bool remove(uint32_t element)
+    {
+        return removeAt(0, element, homePosition(store_->x[element], store_->y[element]));
+    }
+
+    void update(uint32_t element, Vector2 oldPos)
+    {
+        removeAt(0, element, homePosition(oldPos.x, oldPos.y));
+        insert(element);
+    }
+
+    // Re-homes only the elements that left their node's path or loose box
+    void refit()
+    {
+        moved_.clear();
+        refitAt(0);
+        for (uint32_t e : moved_) insertAt(0, e);
+    }
+
+    void setDebugMode(bool d) { debug_ = d; }
+
+    // Elements whose bounds overlap region, each exactly once
+    void rectQuery(const Rectangle &region, std::vector<uint32_t> &found) const
+    {
+        queryAt(0, region, found);
+    }
+
+    // Batched rectQuery in Z-order; hits are bounds overlaps, each exactly once
+    void rectQueryBatch(const std::vector<Rectangle> &queries, QueryBatch &out) const
+    {
+        const Rectangle bounds{center_.x - width_ * 0.5f, center_.y - height_ * 0.5f, width_, height_};
+        runQueryBatch(queries, bounds, out, [this](const Rectangle *rects, uint32_t n, std::vector<uint32_t> *lists) {
+            batchAt(0, rects, (1u << n) - 1, lists);
+        });
+    }
+
+    // Calls fn(uint32_t) for every element whose center is within r of center
+    template <typename Fn>
+    void forEachInRadius(Vector2 center, float r, Fn &&fn) const
+    {
+        radiusAt(0, center, r * r, fn);
+    }
+
+    // The k elements with centers closest to point, nearest first
+    void knn(Vector2 point, size_t k, std::vector<uint32_t> &out) const
+    {
+        KnnHeap<Store> heap(*store_, point, k, out);
+        if (k > 0) knnAt(0, heap);
+        heap.finish();
+    }
+
+    void drawDebug() const
+    {
+        if (!debug_) return;
+        drawAt(0, nullptr);
+    }
+
+    // Only descends into nodes overlapping view (world space)
+    void drawDebug(const Rectangle &view) const
+    {
+        if (!debug_) return;
+        drawAt(0, &view);
+    }
+
+    void rebuild()
+    {
+        const uint32_t count = store_->size();
+        reset();
+        links_.reserve(count);
+        for (uint32_t e = 0; e < count; ++e) insert(e);
+    }
+};
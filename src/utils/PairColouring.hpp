@@ -0,0 +1,57 @@
+// PairColouring.hpp
+#pragma once
+#include <vector>
+#include <cstdint>
+
+// Greedy edge colouring of body pairs (a, b), packed as (a << 32) | b. Two
+// pairs sharing a body never get the same colour, so every colour is a batch
+// that can be solved in parallel without locks. Colours are tracked with one
+// 64-bit mask per body; a pair that finds all 64 taken goes to the spill
+// batch, which has to run serially.
+struct PairColouring
+{
+    static const uint32_t kColours = 64;
+    static const uint32_t kSpill = kColours; // index of the serial batch
+
+    // colour c is pairs[offsets[c], offsets[c + 1]), for c in [0, kSpill]
+    std::vector<uint32_t> offsets;
+    std::vector<uint64_t> pairs;
+
+    // scratch reused between builds
+    std::vector<uint64_t> used;   // per body: colours already touching it
+    std::vector<uint32_t> colour; // per input pair
+
+    // Pairs keep their input order inside a colour, so the result is deterministic
+    void build(const std::vector<uint64_t> &in, uint32_t bodies)
+    {
+        const uint32_t spill = kSpill;
+        used.assign(bodies, 0);
+        colour.resize(in.size());
+        offsets.assign(spill + 2, 0);
+
+        for (size_t k = 0; k < in.size(); ++k)
+        {
+            const uint32_t a = (uint32_t)(in[k] >> 32);
+            const uint32_t b = (uint32_t)(in[k] & 0xFFFFFFFFu);
+            const uint64_t busy = used[a] | used[b];
+            uint32_t c = 0;
+            while (c < spill && (busy >> c) & 1u) ++c;
+            if (c < spill)
+            {
+                used[a] |= 1ull << c;
+                used[b] |= 1ull << c;
+            }
+            colour[k] = c;
+            ++offsets[c + 1];
+        }
+
+        for (uint32_t c = 0; c <= spill; ++c)
+            offsets[c + 1] += offsets[c];
+
+        uint32_t fill[kSpill + 1];
+        for (uint32_t c = 0; c <= spill; ++c) fill[c] = offsets[c];
+        pairs.resize(in.size());
+        for (size_t k = 0; k < in.size(); ++k)
+            pairs[fill[colour[k]]++] = in[k];
+    }
+};
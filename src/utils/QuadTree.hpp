@@ -3,30 +3,85 @@
 #include "raylib.h"
 #include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <memory>
+#include "jobSystem.hpp"
+#include "KnnHeap.hpp"
+#include "QueryBatch.hpp"
+#include "QuadTreeStats.hpp"
 
 static const int max_depth = 10;
 
-template <typename T>
+// Arena backed quadtree: every node lives in one contiguous pool and is
+// addressed by a 32-bit index, so a rebuild is an O(1) reset instead of
+// a new/delete per node.
+//
+// The tree can also be kept alive across frames: update()/remove() move
+// single elements and refit() re-homes only the elements that left their
+// leaf, merging leaves back together as they empty out.
+//
+// Large rebuilds run in parallel on the Jobs pool: the items are split by
+// top-level quadrant, each quadrant builds in its own arena and the four
+// arenas are stitched under the root in the order a serial build would have
+// allocated them, so the result does not depend on the thread count.
+//
+// Elements are 32-bit handles into a Store: a structure of arrays exposing
+// x[i], y[i] and size(). The tree only reads positions through it.
+template <typename Store>
 class QuadTree
 {
 private:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    struct Node
+    {
+        Vector2 center;
+        float width, height;
+        int depth;
+        uint32_t parent;     // kNone for the root
+        uint32_t firstChild; // 4 children stored back to back (TL, TR, BL, BR), kNone for leaves
+        uint32_t firstLink;  // head of this leaf's element list
+        uint32_t count;      // elements stored in this leaf
+    };
+
+    // Leaf element lists are singly linked through one shared pool
+    struct Link
+    {
+        uint32_t element;
+        uint32_t next;
+    };
+
+    const Store *store_;
     bool debug_ = true;                 // off by default for perf
     int capacity_;
     Vector2 center_;
     float width_, height_;
     int depth_;
 
-    bool hasChildren_;
-    std::vector<QuadTree<T> *> children_; // owning raw ptrs
-    std::vector<const T*> elements_;      // store pointers to external elements
+    std::vector<Node> nodes_; // nodes_[0] is the root
+    std::vector<Link> links_;
+    std::vector<uint32_t> freeBlocks_; // first index of released child quads
+    uint32_t freeLink_ = kNone;        // released links, chained through next
+    std::vector<uint32_t> moved_;      // refit scratch
+
+    static const size_t kParallelMinItems = 4096;
+    std::unique_ptr<QuadTree<Store>> parts_[4]; // per-quadrant arenas for the parallel rebuild
+    std::vector<uint32_t> buckets_[4];
+    std::vector<uint32_t> nodeMarks_, linkMarks_; // arena sizes after each insert of a part build
+    std::vector<uint32_t> nodeMap_, linkMap_;     // part index -> index in the stitched arena
 
-    static bool contains(const Vector2 &c, float w, float h, const T &p)
+#ifdef QUADTREE_STATS
+    mutable QuadTreeQueryCounters counters_;
+#endif
+
+    static bool contains(const Node &node, float x, float y)
     {
-        const float left   = c.x - w * 0.5f;
-        const float right  = c.x + w * 0.5f;
-        const float top    = c.y - h * 0.5f;
-        const float bottom = c.y + h * 0.5f;
-        return (p.x >= left && p.x <= right && p.y >= top && p.y <= bottom);
+        const float left   = node.center.x - node.width * 0.5f;
+        const float right  = node.center.x + node.width * 0.5f;
+        const float top    = node.center.y - node.height * 0.5f;
+        const float bottom = node.center.y + node.height * 0.5f;
+        return (x >= left && x <= right && y >= top && y <= bottom);
     }
 
     static bool rectIntersectsNode(const Rectangle& r, const Vector2& c, float w, float h)
@@ -42,119 +97,697 @@ private:
                  r.y + r.height < node.y);
     }
 
-    void collectElements(std::vector<const T*> &out) const
+    static bool onEdge(const Node &node, float x, float y)
+    {
+        return x == node.center.x - node.width * 0.5f || x == node.center.x + node.width * 0.5f ||
+               y == node.center.y - node.height * 0.5f || y == node.center.y + node.height * 0.5f;
+    }
+
+    // Squared distance from c to the closest point of the node (0 inside)
+    static float nodeDist2(const Vector2 &c, const Node &node)
+    {
+        const float dx = std::max(std::fabs(c.x - node.center.x) - node.width * 0.5f, 0.0f);
+        const float dy = std::max(std::fabs(c.y - node.center.y) - node.height * 0.5f, 0.0f);
+        return dx * dx + dy * dy;
+    }
+
+    static bool circleIntersectsNode(const Vector2 &c, float r2, const Node &node)
+    {
+        return nodeDist2(c, node) <= r2;
+    }
+
+    // Elements that drift outside the root are filed under the nearest edge leaf
+    // instead of being dropped, so a maintained tree never loses them.
+    Vector2 homePosition(float x, float y) const
+    {
+        return Vector2{
+            std::min(std::max(x, center_.x - width_ * 0.5f), center_.x + width_ * 0.5f),
+            std::min(std::max(y, center_.y - height_ * 0.5f), center_.y + height_ * 0.5f)};
+    }
+
+    // A boundary element sits in every leaf that touches it; exactly one of them
+    // owns it (half-open bounds, closed on the root's far edges). Used to visit
+    // each element once without deduplicating.
+    bool ownsElement(const Node &node, uint32_t element) const
+    {
+        const Vector2 p = homePosition(store_->x[element], store_->y[element]);
+        const float right  = node.center.x + node.width * 0.5f;
+        const float bottom = node.center.y + node.height * 0.5f;
+        return p.x >= node.center.x - node.width * 0.5f &&
+               p.y >= node.center.y - node.height * 0.5f &&
+               (p.x < right  || right  >= center_.x + width_ * 0.5f) &&
+               (p.y < bottom || bottom >= center_.y + height_ * 0.5f);
+    }
+
+    uint32_t makeNode(const Vector2 &center, float width, float height, int depth, uint32_t parent)
+    {
+        nodes_.push_back(Node{center, width, height, depth, parent, kNone, kNone, 0});
+        return (uint32_t)(nodes_.size() - 1);
+    }
+
+    uint32_t allocLink(uint32_t element)
     {
-        out.insert(out.end(), elements_.begin(), elements_.end());
-        if (hasChildren_)
+        if (freeLink_ != kNone)
         {
-            for (auto *ch : children_) ch->collectElements(out);
+            const uint32_t link = freeLink_;
+            freeLink_ = links_[link].next;
+            links_[link] = Link{element, kNone};
+            return link;
         }
+        links_.push_back(Link{element, kNone});
+        return (uint32_t)(links_.size() - 1);
+    }
+
+    void freeLink(uint32_t link)
+    {
+        links_[link].next = freeLink_;
+        freeLink_ = link;
+    }
+
+    void pushLink(uint32_t n, uint32_t link)
+    {
+        links_[link].next = nodes_[n].firstLink;
+        nodes_[n].firstLink = link;
+        ++nodes_[n].count;
+    }
+
+    void pushElement(uint32_t n, uint32_t element)
+    {
+        pushLink(n, allocLink(element));
+    }
+
+    bool leafHas(uint32_t n, uint32_t element) const
+    {
+        for (uint32_t l = nodes_[n].firstLink; l != kNone; l = links_[l].next)
+            if (links_[l].element == element) return true;
+        return false;
+    }
+
+    bool overCapacity(uint32_t n) const
+    {
+        const int depth = nodes_[n].depth;
+        return depth < max_depth && nodes_[n].count > (uint32_t)capacity_;
+    }
+
+    // TL, TR, BL, BR centers of the quadrants of a node with half extents hw, hh
+    static void quadrantCenters(const Vector2 &c, float hw, float hh, Vector2 out[4])
+    {
+        out[0] = Vector2{c.x - hw * 0.5f, c.y - hh * 0.5f};
+        out[1] = Vector2{c.x + hw * 0.5f, c.y - hh * 0.5f};
+        out[2] = Vector2{c.x - hw * 0.5f, c.y + hh * 0.5f};
+        out[3] = Vector2{c.x + hw * 0.5f, c.y + hh * 0.5f};
     }
 
-    void subdivide()
+    void subdivide(uint32_t n)
     {
-        if (hasChildren_) return;
+        if (nodes_[n].firstChild != kNone) return;
 
-        const float hw = width_  * 0.5f;
-        const float hh = height_ * 0.5f;
+        // copy out: makeNode may reallocate the pool
+        const Node parent = nodes_[n];
+        const float hw = parent.width  * 0.5f;
+        const float hh = parent.height * 0.5f;
 
-        const Vector2 cTL{center_.x - hw * 0.5f, center_.y - hh * 0.5f};
-        const Vector2 cTR{center_.x + hw * 0.5f, center_.y - hh * 0.5f};
-        const Vector2 cBL{center_.x - hw * 0.5f, center_.y + hh * 0.5f};
-        const Vector2 cBR{center_.x + hw * 0.5f, center_.y + hh * 0.5f};
+        Vector2 centers[4];
+        quadrantCenters(parent.center, hw, hh, centers);
 
-        children_.reserve(4);
-        children_.push_back(new QuadTree<T>(cTL, hw, hh, capacity_, depth_ + 1));
-        children_.push_back(new QuadTree<T>(cTR, hw, hh, capacity_, depth_ + 1));
-        children_.push_back(new QuadTree<T>(cBL, hw, hh, capacity_, depth_ + 1));
-        children_.push_back(new QuadTree<T>(cBR, hw, hh, capacity_, depth_ + 1));
+        uint32_t first;
+        if (!freeBlocks_.empty())
+        {
+            first = freeBlocks_.back();
+            freeBlocks_.pop_back();
+            for (uint32_t i = 0; i < 4; ++i)
+                nodes_[first + i] = Node{centers[i], hw, hh, parent.depth + 1, n, kNone, kNone, 0};
+        }
+        else
+        {
+            first = makeNode(centers[0], hw, hh, parent.depth + 1, n);
+            for (uint32_t i = 1; i < 4; ++i)
+                makeNode(centers[i], hw, hh, parent.depth + 1, n);
+        }
 
-        hasChildren_ = true;
+        nodes_[n].firstChild = first;
+        nodes_[n].firstLink = kNone;
+        nodes_[n].count = 0;
 
-        // Push current elements down
-        for (const auto* e : elements_)
+        // Push current elements down, reusing each link for its first child
+        uint32_t link = parent.firstLink;
+        while (link != kNone)
         {
-            for (auto *ch : children_)
-                if (contains(ch->center_, ch->width_, ch->height_, *e))
-                    ch->insert(e);
+            const uint32_t next = links_[link].next;
+            const uint32_t e = links_[link].element;
+            const Vector2 p = homePosition(store_->x[e], store_->y[e]);
+            bool placed = false;
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                const uint32_t ch = first + i;
+                if (!contains(nodes_[ch], p.x, p.y)) continue;
+                if (!placed)
+                {
+                    pushLink(ch, link);
+                    placed = true;
+                }
+                else
+                    pushElement(ch, e);
+            }
+            link = next;
         }
-        elements_.clear();
+
+        for (uint32_t i = 0; i < 4; ++i)
+            if (overCapacity(first + i))
+                subdivide(first + i);
     }
 
-    void clearChildren()
+    // Collapse n's four children back into n when they are all leaves and fit in one
+    bool tryMerge(uint32_t n)
     {
-        if (!hasChildren_) return;
-        for (auto *ch : children_) delete ch;
-        children_.clear();
-        hasChildren_ = false;
-    }
+        const uint32_t first = nodes_[n].firstChild;
+        if (first == kNone) return false;
 
-public:
-    QuadTree(const Vector2 &center, float width, float height, int capacity, int depth)
-        : capacity_(capacity), center_(center), width_(width), height_(height),
-          depth_(depth), hasChildren_(false) {}
+        uint32_t total = 0;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            if (nodes_[first + i].firstChild != kNone) return false;
+            total += nodes_[first + i].count;
+        }
+        if (total > (uint32_t)capacity_) return false;
 
-    ~QuadTree() { clearChildren(); }
+        nodes_[n].firstChild = kNone;
+        nodes_[n].firstLink = kNone;
+        nodes_[n].count = 0;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            uint32_t link = nodes_[first + i].firstLink;
+            while (link != kNone)
+            {
+                const uint32_t next = links_[link].next;
+                // boundary elements live in several children; keep one copy
+                if (leafHas(n, links_[link].element))
+                    freeLink(link);
+                else
+                    pushLink(n, link);
+                link = next;
+            }
+        }
+        freeBlocks_.push_back(first);
+        return true;
+    }
 
-    void insert(const T* element)
+    void insertAt(uint32_t n, uint32_t element, const Vector2 &p, bool unique)
     {
-        if (hasChildren_)
+        const uint32_t first = nodes_[n].firstChild;
+        if (first != kNone)
         {
-            for (auto *ch : children_)
-                if (contains(ch->center_, ch->width_, ch->height_, *element))
-                    ch->insert(element);
+            for (uint32_t i = 0; i < 4; ++i)
+                if (contains(nodes_[first + i], p.x, p.y))
+                    insertAt(first + i, element, p, unique);
             return;
         }
 
+        if (unique && leafHas(n, element)) return;
+        pushElement(n, element);
+
         // If capacity exceeded & we can subdivide, do so once we insert
-        if (!hasChildren_ && depth_ < max_depth && elements_.size() >= (size_t)capacity_)
+        if (overCapacity(n))
+            subdivide(n);
+    }
+
+    bool removeAt(uint32_t n, uint32_t element, const Vector2 &p)
+    {
+        if (!contains(nodes_[n], p.x, p.y)) return false;
+
+        const uint32_t first = nodes_[n].firstChild;
+        if (first != kNone)
         {
-            elements_.push_back(element);
-            subdivide();
-            return;
+            bool removed = false;
+            for (uint32_t i = 0; i < 4; ++i)
+                removed |= removeAt(first + i, element, p);
+            if (removed) tryMerge(n);
+            return removed;
         }
 
-        elements_.push_back(element);
+        uint32_t *prev = &nodes_[n].firstLink;
+        while (*prev != kNone)
+        {
+            const uint32_t link = *prev;
+            if (links_[link].element == element)
+            {
+                *prev = links_[link].next;
+                freeLink(link);
+                --nodes_[n].count;
+                return true;
+            }
+            prev = &links_[link].next;
+        }
+        return false;
     }
 
-    void setDebugMode(bool d) { debug_ = d; }
+    // Drop elements that left their leaf into moved_, merging emptied quads on the way up
+    void refitAt(uint32_t n)
+    {
+        const uint32_t first = nodes_[n].firstChild;
+        if (first != kNone)
+        {
+            for (uint32_t i = 0; i < 4; ++i)
+                refitAt(first + i);
+            tryMerge(n);
+            return;
+        }
+
+        uint32_t *prev = &nodes_[n].firstLink;
+        while (*prev != kNone)
+        {
+            const uint32_t link = *prev;
+            const uint32_t e = links_[link].element;
+            const Vector2 p = homePosition(store_->x[e], store_->y[e]);
+            if (contains(nodes_[n], p.x, p.y))
+            {
+                // landed on an edge: the leaves across it need a copy too
+                if (onEdge(nodes_[n], p.x, p.y))
+                    moved_.push_back(e);
+                prev = &links_[link].next;
+                continue;
+            }
+            *prev = links_[link].next;
+            freeLink(link);
+            --nodes_[n].count;
+            moved_.push_back(e);
+        }
+    }
 
-    // Rectangle query (broadphase); returns pointers potentially overlapping region.
-    void rectQuery(const Rectangle &region, std::vector<const T *> &found) const
+    void queryAt(uint32_t n, const Rectangle &region, std::vector<uint32_t> &found) const
     {
-        if (!rectIntersectsNode(region, center_, width_, height_)) return;
+        const Node &node = nodes_[n];
+        QT_STAT(++counters_.nodesVisited);
+        if (!rectIntersectsNode(region, node.center, node.width, node.height)) return;
 
-        if (!hasChildren_)
+        if (node.firstChild == kNone)
         {
             // Add all elements in this leaf
-            found.insert(found.end(), elements_.begin(), elements_.end());
+            for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+                found.push_back(links_[l].element);
+            QT_STAT(counters_.candidates += node.count);
             return;
         }
 
-        for (const auto *ch : children_)
-            ch->rectQuery(region, found);
+        for (uint32_t i = 0; i < 4; ++i)
+            queryAt(node.firstChild + i, region, found);
     }
 
-    void drawDebug() const
+    template <typename Fn>
+    void radiusAt(uint32_t n, const Vector2 &c, float r2, Fn &fn) const
     {
-        if (!debug_) return;
+        const Node &node = nodes_[n];
+        QT_STAT(++counters_.nodesVisited);
+        if (!circleIntersectsNode(c, r2, node)) return;
+
+        if (node.firstChild == kNone)
+        {
+            for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+            {
+                const uint32_t e = links_[l].element;
+                const float dx = store_->x[e] - c.x;
+                const float dy = store_->y[e] - c.y;
+                if (dx * dx + dy * dy <= r2 && ownsElement(node, e))
+                {
+                    QT_STAT(++counters_.candidates);
+                    fn(e);
+                }
+            }
+            return;
+        }
+
+        for (uint32_t i = 0; i < 4; ++i)
+            radiusAt(node.firstChild + i, c, r2, fn);
+    }
+
+    // Packet traversal: mask holds the queries still overlapping this subtree
+    void batchAt(uint32_t n, const Rectangle *rects, uint32_t mask, std::vector<uint32_t> *lists) const
+    {
+        const Node &node = nodes_[n];
+        QT_STAT(++counters_.nodesVisited);
+        uint32_t live = 0;
+        for (uint32_t i = 0; (mask >> i) != 0; ++i)
+            if (((mask >> i) & 1u) && rectIntersectsNode(rects[i], node.center, node.width, node.height))
+                live |= 1u << i;
+        if (live == 0) return;
+
+        if (node.firstChild == kNone)
+        {
+            for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+            {
+                const uint32_t e = links_[l].element;
+                if (!ownsElement(node, e)) continue;
+                for (uint32_t i = 0; (live >> i) != 0; ++i)
+                    if (((live >> i) & 1u) && pointInRect(rects[i], store_->x[e], store_->y[e]))
+                        lists[i].push_back(e);
+            }
+            return;
+        }
+
+        for (uint32_t i = 0; i < 4; ++i)
+            batchAt(node.firstChild + i, rects, live, lists);
+    }
+
+    // Depth first, nearest child first; subtrees farther than the current k-th
+    // candidate are pruned
+    void knnAt(uint32_t n, KnnHeap<Store> &heap) const
+    {
+        const Node &node = nodes_[n];
+        QT_STAT(++counters_.nodesVisited);
+        if (node.firstChild == kNone)
+        {
+            for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+                if (ownsElement(node, links_[l].element))
+                    heap.offer(links_[l].element);
+            return;
+        }
+
+        float d[4];
+        uint32_t order[4] = {0, 1, 2, 3};
+        for (uint32_t i = 0; i < 4; ++i) d[i] = nodeDist2(heap.point, nodes_[node.firstChild + i]);
+        std::sort(order, order + 4, [&](uint32_t a, uint32_t b) { return d[a] < d[b]; });
+
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            if (d[order[i]] > heap.worst()) break;
+            knnAt(node.firstChild + order[i], heap);
+        }
+    }
+
+    void statsAt(uint32_t n, QuadTreeStats &st) const
+    {
+        const Node &node = nodes_[n];
+        ++st.nodes;
+        if (node.firstChild != kNone)
+        {
+            for (uint32_t i = 0; i < 4; ++i) statsAt(node.firstChild + i, st);
+            return;
+        }
+
+        ++st.leaves;
+        ++st.depthHistogram[std::min(node.depth, max_depth)];
+        ++st.occupancyHistogram[std::min<uint32_t>(node.count, (uint32_t)capacity_ + 1)];
+        for (uint32_t l = node.firstLink; l != kNone; l = links_[l].next)
+        {
+            if (ownsElement(node, links_[l].element))
+                ++st.elements;
+            else
+                ++st.duplicates;
+        }
+    }
+
+    // view == nullptr draws the whole tree
+    void drawAt(uint32_t n, const Rectangle *view) const
+    {
+        const Node &node = nodes_[n];
+        if (view && !rectIntersectsNode(*view, node.center, node.width, node.height)) return;
         DrawRectangleLines(
-            (center_.x - width_ * 0.5f),
-            (center_.y - height_ * 0.5f),
-            (width_),
-            (height_),
+            (node.center.x - node.width * 0.5f),
+            (node.center.y - node.height * 0.5f),
+            (node.width),
+            (node.height),
             ORANGE);
-        if (hasChildren_)
-            for (auto *ch : children_) ch->drawDebug();
+        if (node.firstChild != kNone)
+            for (uint32_t i = 0; i < 4; ++i) drawAt(node.firstChild + i, view);
+    }
+
+    // O(1) for the trivially destructible pools; capacity is kept for the next build
+    void reset()
+    {
+        nodes_.clear();
+        links_.clear();
+        freeBlocks_.clear();
+        freeLink_ = kNone;
+        makeNode(center_, width_, height_, depth_, kNone);
+    }
+
+    // marked records the arena sizes after every insert, which the parallel
+    // build uses to put each part's allocations back in serial order
+    void buildSerial(const std::vector<uint32_t> &items, bool marked = false)
+    {
+        reset();
+        links_.reserve(items.size());
+        nodeMarks_.clear();
+        linkMarks_.clear();
+        for (uint32_t e : items)
+        {
+            insert(e);
+            if (!marked) continue;
+            nodeMarks_.push_back((uint32_t)nodes_.size());
+            linkMarks_.push_back((uint32_t)links_.size());
+        }
+    }
+
+    // Produces the same arena as buildSerial(0..count-1), index for index.
+    //
+    // A serial build holds the first capacity + 1 elements (the seed) in the
+    // root until it splits, then pushes them down newest first, so the parts
+    // get the seed in that order and the rest ascending. Each seed element's
+    // first link keeps its serial index (the root allocated it), copies into
+    // further quadrants follow in push-down order, and everything allocated
+    // later is merged back by (element, quadrant), the order in which the
+    // serial insert visits the children.
+    void buildParallel(uint32_t count)
+    {
+        reset();
+
+        const float hw = width_ * 0.5f, hh = height_ * 0.5f;
+        Vector2 centers[4];
+        quadrantCenters(center_, hw, hh, centers);
+
+        // Partition by quadrant with the same inclusive test insert() uses
+        Node quads[4];
+        for (uint32_t q = 0; q < 4; ++q)
+        {
+            quads[q] = Node{centers[q], hw, hh, depth_ + 1, 0, kNone, kNone, 0};
+            buckets_[q].clear();
+            if (!parts_[q])
+                parts_[q].reset(new QuadTree<Store>(*store_, centers[q], hw, hh, capacity_, depth_ + 1));
+        }
+        const uint32_t seed = (uint32_t)capacity_ + 1;
+        const auto bucket = [&](uint32_t e) {
+            const Vector2 p = homePosition(store_->x[e], store_->y[e]);
+            for (uint32_t q = 0; q < 4; ++q)
+                if (contains(quads[q], p.x, p.y)) buckets_[q].push_back(e);
+        };
+        uint32_t seeded[4];
+        for (uint32_t e = seed; e-- > 0;)
+            bucket(e);
+        for (uint32_t q = 0; q < 4; ++q)
+            seeded[q] = (uint32_t)buckets_[q].size();
+        for (uint32_t e = seed; e < count; ++e)
+            bucket(e);
+
+        Jobs::parallelFor(4, [&](uint32_t q) { parts_[q]->buildSerial(buckets_[q], true); });
+
+        // Seed links: the first quadrant keeps the root's link, the others copy
+        uint32_t nodeNext = 5, linkNext = seed;
+        uint32_t cursor[4] = {0, 0, 0, 0};
+        for (uint32_t q = 0; q < 4; ++q)
+        {
+            parts_[q]->nodeMap_.assign(parts_[q]->nodes_.size(), 0);
+            parts_[q]->linkMap_.assign(parts_[q]->links_.size(), 0);
+            parts_[q]->nodeMap_[0] = 1 + q;
+        }
+        for (uint32_t e = seed; e-- > 0;)
+        {
+            bool first = true;
+            for (uint32_t q = 0; q < 4; ++q)
+            {
+                if (cursor[q] == seeded[q] || buckets_[q][cursor[q]] != e) continue;
+                parts_[q]->linkMap_[cursor[q]++] = first ? e : linkNext++;
+                first = false;
+            }
+        }
+
+        // Later allocations: insert k of part q happened at serial time
+        // buckets_[q][k], or at the root split for the seed
+        for (uint32_t q = 0; q < 4; ++q)
+            cursor[q] = seeded[q] ? seeded[q] - 1 : 0;
+        const auto timeOf = [&](uint32_t q) {
+            return cursor[q] < seeded[q] ? seed - 1 : buckets_[q][cursor[q]];
+        };
+        for (;;)
+        {
+            uint32_t q = 4;
+            for (uint32_t i = 0; i < 4; ++i)
+                if (cursor[i] < (uint32_t)buckets_[i].size() && (q == 4 || timeOf(i) < timeOf(q)))
+                    q = i;
+            if (q == 4) break;
+
+            QuadTree<Store> &part = *parts_[q];
+            const uint32_t k = cursor[q]++;
+            const uint32_t nodeLo = k == 0 ? 1 : part.nodeMarks_[k - 1];
+            const uint32_t linkLo = k + 1 == seeded[q] ? seeded[q] : (k == 0 ? 0 : part.linkMarks_[k - 1]);
+            for (uint32_t i = nodeLo; i < part.nodeMarks_[k]; ++i)
+                part.nodeMap_[i] = nodeNext++;
+            for (uint32_t l = linkLo; l < part.linkMarks_[k]; ++l)
+                part.linkMap_[l] = linkNext++;
+        }
+
+        nodes_.resize(nodeNext);
+        links_.resize(linkNext);
+        nodes_[0].firstChild = 1;
+
+        Jobs::parallelFor(4, [&](uint32_t q) {
+            const QuadTree<Store> &part = *parts_[q];
+            const auto mapNode = [&](uint32_t i) -> uint32_t { return i == kNone ? kNone : part.nodeMap_[i]; };
+            const auto mapLink = [&](uint32_t l) -> uint32_t { return l == kNone ? kNone : part.linkMap_[l]; };
+
+            for (uint32_t i = 0; i < (uint32_t)part.nodes_.size(); ++i)
+            {
+                Node node = part.nodes_[i];
+                node.parent = (i == 0) ? 0 : mapNode(node.parent);
+                node.firstChild = mapNode(node.firstChild);
+                node.firstLink = mapLink(node.firstLink);
+                nodes_[mapNode(i)] = node;
+            }
+            for (uint32_t l = 0; l < (uint32_t)part.links_.size(); ++l)
+                links_[mapLink(l)] = Link{part.links_[l].element, mapLink(part.links_[l].next)};
+        });
+    }
+
+public:
+    QuadTree(const Store &store, const Vector2 &center, float width, float height, int capacity, int depth)
+        : store_(&store), capacity_(capacity), center_(center), width_(width), height_(height),
+          depth_(depth)
+    {
+        reset();
     }
 
-    // Rebuild from an external authoritative set of items (recommended)
-    void rebuild(const std::vector<T*> &items)
+    void insert(uint32_t element)
     {
-        clearChildren();
-        elements_.clear();
-        hasChildren_ = false;
-        elements_.reserve(items.size());
-        for (const T* e : items) insert(e);
+        insertAt(0, element, homePosition(store_->x[element], store_->y[element]), false);
+    }
+
+    // Removes an element that has not moved since it was inserted or last refit
+    bool remove(uint32_t element)
+    {
+        return removeAt(0, element, homePosition(store_->x[element], store_->y[element]));
+    }
+
+    // Re-homes an element that moved away from oldPos
+    void update(uint32_t element, Vector2 oldPos)
+    {
+        removeAt(0, element, homePosition(oldPos.x, oldPos.y));
+        insert(element);
+    }
+
+    // Bulk maintenance after elements moved: only the ones that crossed a leaf
+    // boundary are unlinked and re-inserted, everything else stays in place.
+    void refit()
+    {
+        moved_.clear();
+        refitAt(0);
+        std::sort(moved_.begin(), moved_.end());
+        moved_.erase(std::unique(moved_.begin(), moved_.end()), moved_.end());
+        for (uint32_t e : moved_)
+            insertAt(0, e, homePosition(store_->x[e], store_->y[e]), true);
+    }
+
+    void setDebugMode(bool d) { debug_ = d; }
+
+    // Rectangle query (broadphase); returns handles potentially overlapping region.
+    void rectQuery(const Rectangle &region, std::vector<uint32_t> &found) const
+    {
+        QT_STAT(++counters_.queries);
+        queryAt(0, region, found);
+    }
+
+    // Answers many rectangle queries at once. Queries are ordered along a Z-order
+    // curve and neighbouring ones share a traversal; unlike rectQuery the results
+    // are exact (position inside the rectangle) and free of duplicates.
+    void rectQueryBatch(const std::vector<Rectangle> &queries, QueryBatch &out) const
+    {
+        const Rectangle bounds{center_.x - width_ * 0.5f, center_.y - height_ * 0.5f, width_, height_};
+        runQueryBatch(queries, bounds, out, [this](const Rectangle *rects, uint32_t n, std::vector<uint32_t> *lists) {
+            batchAt(0, rects, (1u << n) - 1, lists);
+        });
+        QT_STAT(counters_.queries += queries.size());
+        QT_STAT(counters_.candidates += out.items.size());
+    }
+
+    // Calls fn(uint32_t) once for every element within r of center; nothing is
+    // collected, nodes outside the circle are skipped and leaf elements are
+    // filtered by exact distance.
+    template <typename Fn>
+    void forEachInRadius(Vector2 center, float r, Fn &&fn) const
+    {
+        QT_STAT(++counters_.queries);
+        radiusAt(0, center, r * r, fn);
+    }
+
+    // The k elements closest to point, nearest first. out doubles as the
+    // bounded heap, so reusing it keeps queries allocation free.
+    void knn(Vector2 point, size_t k, std::vector<uint32_t> &out) const
+    {
+        KnnHeap<Store> heap(*store_, point, k, out);
+        if (k > 0) knnAt(0, heap);
+        heap.finish();
+        QT_STAT(++counters_.queries);
+        QT_STAT(counters_.candidates += out.size());
+    }
+
+    // Walks the tree for its shape; query counters are filled in stats builds only
+    QuadTreeStats stats() const
+    {
+        QuadTreeStats st;
+        st.depthHistogram.assign(max_depth + 1, 0);
+        st.occupancyHistogram.assign(capacity_ + 2, 0);
+        statsAt(0, st);
+
+        st.bytesAllocated = nodes_.capacity() * sizeof(Node) + links_.capacity() * sizeof(Link) +
+                            freeBlocks_.capacity() * sizeof(uint32_t) + moved_.capacity() * sizeof(uint32_t) +
+                            (nodeMarks_.capacity() + linkMarks_.capacity() + nodeMap_.capacity() +
+                             linkMap_.capacity()) * sizeof(uint32_t);
+        for (uint32_t q = 0; q < 4; ++q)
+        {
+            st.bytesAllocated += buckets_[q].capacity() * sizeof(uint32_t);
+            if (parts_[q]) st.bytesAllocated += parts_[q]->stats().bytesAllocated;
+        }
+#ifdef QUADTREE_STATS
+        st.queries = counters_.queries;
+        st.nodesVisited = counters_.nodesVisited;
+        st.candidates = counters_.candidates;
+#endif
+        return st;
+    }
+
+    void resetQueryStats()
+    {
+#ifdef QUADTREE_STATS
+        counters_.queries = 0;
+        counters_.nodesVisited = 0;
+        counters_.candidates = 0;
+#endif
+    }
+
+    void drawDebug() const
+    {
+        if (!debug_) return;
+        drawAt(0, nullptr);
+    }
+
+    // Only descends into nodes overlapping view (world space)
+    void drawDebug(const Rectangle &view) const
+    {
+        if (!debug_) return;
+        drawAt(0, &view);
+    }
+
+    // Rebuild over every handle in the store (recommended).
+    // Goes parallel for large inputs once Jobs::init() started workers.
+    void rebuild()
+    {
+        const uint32_t count = store_->size();
+        if (count >= kParallelMinItems && count > (uint32_t)capacity_ &&
+            depth_ < max_depth && Jobs::threadCount() > 1)
+        {
+            buildParallel(count);
+            return;
+        }
+        reset();
+        links_.reserve(count);
+        for (uint32_t e = 0; e < count; ++e) insert(e);
     }
 };
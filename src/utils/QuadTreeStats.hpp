@@ -0,0 +1,88 @@
+// QuadTreeStats.hpp
+#pragma once
+#include "raylib.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <atomic>
+
+// Query counters are only compiled in with -DQUADTREE_STATS; without it
+// QT_STAT(...) expands to nothing and the tree carries no extra state.
+#ifdef QUADTREE_STATS
+#define QT_STAT(stmt) stmt
+#else
+#define QT_STAT(stmt)
+#endif
+
+struct QuadTreeQueryCounters
+{
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> nodesVisited{0};
+    std::atomic<uint64_t> candidates{0};
+};
+
+// Snapshot of a tree's shape and, in stats builds, of the query cost since
+// the last reset
+struct QuadTreeStats
+{
+    uint32_t nodes = 0;
+    uint32_t leaves = 0;
+    uint32_t elements = 0;   // distinct elements
+    uint32_t duplicates = 0; // extra copies stored because contains() is boundary inclusive
+    uint64_t bytesAllocated = 0;
+    std::vector<uint32_t> depthHistogram;     // leaves per depth
+    std::vector<uint32_t> occupancyHistogram; // leaves per element count, last bin is "over capacity"
+
+    uint64_t queries = 0;
+    uint64_t nodesVisited = 0;
+    uint64_t candidates = 0;
+
+    static std::string jsonArray(const std::vector<uint32_t> &v)
+    {
+        std::string s = "[";
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            if (i) s += ", ";
+            s += std::to_string(v[i]);
+        }
+        return s + "]";
+    }
+
+    std::string toJson() const
+    {
+        std::string s = "{\n";
+        s += "  \"nodes\": " + std::to_string(nodes) + ",\n";
+        s += "  \"leaves\": " + std::to_string(leaves) + ",\n";
+        s += "  \"elements\": " + std::to_string(elements) + ",\n";
+        s += "  \"duplicates\": " + std::to_string(duplicates) + ",\n";
+        s += "  \"bytesAllocated\": " + std::to_string(bytesAllocated) + ",\n";
+        s += "  \"depthHistogram\": " + jsonArray(depthHistogram) + ",\n";
+        s += "  \"occupancyHistogram\": " + jsonArray(occupancyHistogram) + ",\n";
+        s += "  \"queries\": " + std::to_string(queries) + ",\n";
+        s += "  \"nodesVisited\": " + std::to_string(nodesVisited) + ",\n";
+        s += "  \"candidates\": " + std::to_string(candidates) + "\n";
+        return s + "}\n";
+    }
+
+    // Screen space text block plus an occupancy bar chart
+    void drawOverlay(int x, int y) const
+    {
+        const int fs = 20;
+        const double perQuery = queries ? 1.0 / (double)queries : 0.0;
+        DrawText(TextFormat("nodes %u  leaves %u", nodes, leaves), x, y, fs, ORANGE);
+        DrawText(TextFormat("elements %u  duplicates %u", elements, duplicates), x, y + 24, fs, ORANGE);
+        DrawText(TextFormat("memory %.1f KiB", bytesAllocated / 1024.0), x, y + 48, fs, ORANGE);
+        DrawText(TextFormat("queries %llu  nodes/q %.1f  cand/q %.1f", (unsigned long long)queries,
+                            nodesVisited * perQuery, candidates * perQuery), x, y + 72, fs, ORANGE);
+
+        uint32_t peak = 1;
+        for (uint32_t c : occupancyHistogram) peak = c > peak ? c : peak;
+        const int barW = 12, barH = 80, top = y + 104;
+        DrawText("leaf occupancy", x, top + barH + 4, fs, ORANGE);
+        for (size_t i = 0; i < occupancyHistogram.size(); ++i)
+        {
+            const int h = (int)(barH * (float)occupancyHistogram[i] / (float)peak);
+            DrawRectangle(x + (int)i * (barW + 2), top + barH - h, barW, h, ORANGE);
+        }
+    }
+};
@@ -0,0 +1,76 @@
+// QueryBatch.hpp
+#pragma once
+#include "raylib.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "dorMath.hpp"
+
+// Results of a batched rectangle query in CSR form. Queries are answered in
+// Morton order of their centers: the j-th answered query is query[j] of the
+// input, and its results are items[offsets[j], offsets[j + 1]).
+struct QueryBatch
+{
+    static const uint32_t kPacket = 16; // queries sharing one traversal
+
+    std::vector<uint32_t> query;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> items;
+
+    // scratch reused between batches
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> lists[kPacket];
+
+    size_t size() const { return query.size(); }
+    const uint32_t *begin(size_t j) const { return items.data() + offsets[j]; }
+    const uint32_t *end(size_t j) const { return items.data() + offsets[j + 1]; }
+};
+
+static inline bool pointInRect(const Rectangle &r, float x, float y)
+{
+    return x >= r.x && x <= r.x + r.width && y >= r.y && y <= r.y + r.height;
+}
+
+// Sorts the queries along a Z-order curve over bounds and hands them to
+// packet(rects, n, lists) kPacket at a time; packet appends the hits of
+// rects[i] to lists[i]. Packets are then flattened into out.
+template <typename PacketFn>
+static void runQueryBatch(const std::vector<Rectangle> &queries, const Rectangle &bounds,
+                          QueryBatch &out, PacketFn &&packet)
+{
+    const uint32_t count = (uint32_t)queries.size();
+    out.keys.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const Rectangle &q = queries[i];
+        const uint64_t code = morton_encode(q.x + q.width * 0.5f, q.y + q.height * 0.5f, bounds);
+        out.keys[i] = (code << 32) | i;
+    }
+    std::sort(out.keys.begin(), out.keys.end());
+
+    out.query.resize(count);
+    out.offsets.resize(count + 1);
+    out.items.clear();
+    out.offsets[0] = 0;
+
+    const uint32_t packetSize = QueryBatch::kPacket;
+    Rectangle rects[QueryBatch::kPacket];
+    for (uint32_t first = 0; first < count; first += packetSize)
+    {
+        const uint32_t n = std::min(packetSize, count - first);
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            out.query[first + i] = (uint32_t)(out.keys[first + i] & 0xFFFFFFFFu);
+            rects[i] = queries[out.query[first + i]];
+            out.lists[i].clear();
+        }
+
+        packet(rects, n, out.lists);
+
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            out.items.insert(out.items.end(), out.lists[i].begin(), out.lists[i].end());
+            out.offsets[first + i + 1] = (uint32_t)out.items.size();
+        }
+    }
+}
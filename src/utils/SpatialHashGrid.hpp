@@ -0,0 +1,276 @@
+// SpatialHashGrid.hpp
+#pragma once
+#include "raylib.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include "KnnHeap.hpp"
+#include "QueryBatch.hpp"
+
+// Uniform grid over a fixed world rectangle. Built with a counting sort:
+// every cell is a [start, start + count) slice of one flat array, so there
+// are no per-cell vectors. With the cell size equal to the query radius a
+// radius query touches at most 3x3 cells. Same query contract as QuadTree<Store>.
+template <typename Store>
+class SpatialHashGrid
+{
+private:
+    const Store *store_;
+    bool debug_ = true;
+    Vector2 origin_; // top-left corner of the world
+    float width_, height_;
+    float cellSize_, invCellSize_;
+    int cols_, rows_;
+
+    std::vector<uint32_t> cellStart_; // cols_ * rows_ + 1 prefix offsets
+    std::vector<uint32_t> cellCount_; // live elements per cell, at most the slice length
+    std::vector<uint32_t> sorted_;    // elements grouped by cell
+    std::vector<uint32_t> pending_;   // inserted since the last build, scanned linearly
+    std::vector<uint32_t> cellOf_;    // build scratch
+    std::vector<uint32_t> gather_;    // refit scratch
+
+    int cellX(float x) const
+    {
+        const int c = (int)std::floor((x - origin_.x) * invCellSize_);
+        return std::min(std::max(c, 0), cols_ - 1);
+    }
+
+    int cellY(float y) const
+    {
+        const int c = (int)std::floor((y - origin_.y) * invCellSize_);
+        return std::min(std::max(c, 0), rows_ - 1);
+    }
+
+    uint32_t cellIndex(float x, float y) const
+    {
+        return (uint32_t)(cellY(y) * cols_ + cellX(x));
+    }
+
+    void build(const std::vector<uint32_t> &src)
+    {
+        const size_t cells = cellCount_.size();
+        std::fill(cellCount_.begin(), cellCount_.end(), 0u);
+        cellOf_.resize(src.size());
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            cellOf_[i] = cellIndex(store_->x[src[i]], store_->y[src[i]]);
+            ++cellCount_[cellOf_[i]];
+        }
+
+        cellStart_[0] = 0;
+        for (size_t c = 0; c < cells; ++c)
+            cellStart_[c + 1] = cellStart_[c] + cellCount_[c];
+
+        sorted_.resize(src.size());
+        std::fill(cellCount_.begin(), cellCount_.end(), 0u);
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            const uint32_t c = cellOf_[i];
+            sorted_[cellStart_[c] + cellCount_[c]++] = src[i];
+        }
+        pending_.clear();
+    }
+
+    static bool eraseFrom(std::vector<uint32_t> &v, uint32_t element)
+    {
+        auto it = std::find(v.begin(), v.end(), element);
+        if (it == v.end()) return false;
+        *it = v.back();
+        v.pop_back();
+        return true;
+    }
+
+    bool eraseAt(uint32_t element, float x, float y)
+    {
+        const uint32_t c = cellIndex(x, y);
+        const uint32_t begin = cellStart_[c];
+        const uint32_t end = begin + cellCount_[c];
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            if (sorted_[i] != element) continue;
+            sorted_[i] = sorted_[end - 1];
+            --cellCount_[c];
+            return true;
+        }
+        return eraseFrom(pending_, element);
+    }
+
+public:
+    SpatialHashGrid(const Store &store, const Vector2 &center, float width, float height, float cellSize)
+        : store_(&store), origin_{center.x - width * 0.5f, center.y - height * 0.5f},
+          width_(width), height_(height), cellSize_(cellSize), invCellSize_(1.0f / cellSize),
+          cols_(std::max(1, (int)std::ceil(width / cellSize))),
+          rows_(std::max(1, (int)std::ceil(height / cellSize))),
+          cellStart_((size_t)cols_ * rows_ + 1, 0u),
+          cellCount_((size_t)cols_ * rows_, 0u) {}
+
+    // Kept in a side list until the next rebuild()/refit()
+    void insert(uint32_t element) { pending_.push_back(element); }
+
+    // Removes an element that has not moved since it was inserted or last refit
+    bool remove(uint32_t element) { return eraseAt(element, store_->x[element], store_->y[element]); }
+
+    void update(uint32_t element, Vector2 oldPos)
+    {
+        eraseAt(element, oldPos.x, oldPos.y);
+        insert(element);
+    }
+
+    // Re-bins every live element; linear time, so a refit is just a rebuild
+    void refit()
+    {
+        gather_.clear();
+        for (size_t c = 0; c < cellCount_.size(); ++c)
+            gather_.insert(gather_.end(), sorted_.begin() + cellStart_[c],
+                           sorted_.begin() + cellStart_[c] + cellCount_[c]);
+        gather_.insert(gather_.end(), pending_.begin(), pending_.end());
+        build(gather_);
+    }
+
+    void setDebugMode(bool d) { debug_ = d; }
+
+    // Rectangle query (broadphase); returns every element of the covered cells.
+    void rectQuery(const Rectangle &region, std::vector<uint32_t> &found) const
+    {
+        const int x0 = cellX(region.x), x1 = cellX(region.x + region.width);
+        const int y0 = cellY(region.y), y1 = cellY(region.y + region.height);
+        for (int cy = y0; cy <= y1; ++cy)
+        {
+            for (int cx = x0; cx <= x1; ++cx)
+            {
+                const uint32_t c = (uint32_t)(cy * cols_ + cx);
+                found.insert(found.end(), sorted_.begin() + cellStart_[c],
+                             sorted_.begin() + cellStart_[c] + cellCount_[c]);
+            }
+        }
+        for (uint32_t e : pending_)
+            if (store_->x[e] >= region.x && store_->x[e] <= region.x + region.width &&
+                store_->y[e] >= region.y && store_->y[e] <= region.y + region.height)
+                found.push_back(e);
+    }
+
+    // Answers many rectangle queries at once in Z-order so consecutive queries
+    // hit neighbouring cells; results are exact (position inside the rectangle)
+    void rectQueryBatch(const std::vector<Rectangle> &queries, QueryBatch &out) const
+    {
+        const Rectangle bounds{origin_.x, origin_.y, width_, height_};
+        runQueryBatch(queries, bounds, out, [&](const Rectangle *rects, uint32_t n, std::vector<uint32_t> *lists) {
+            for (uint32_t q = 0; q < n; ++q)
+            {
+                const Rectangle &r = rects[q];
+                const int x0 = cellX(r.x), x1 = cellX(r.x + r.width);
+                const int y0 = cellY(r.y), y1 = cellY(r.y + r.height);
+                for (int cy = y0; cy <= y1; ++cy)
+                {
+                    for (int cx = x0; cx <= x1; ++cx)
+                    {
+                        const uint32_t c = (uint32_t)(cy * cols_ + cx);
+                        for (uint32_t i = cellStart_[c]; i < cellStart_[c] + cellCount_[c]; ++i)
+                            if (pointInRect(r, store_->x[sorted_[i]], store_->y[sorted_[i]]))
+                                lists[q].push_back(sorted_[i]);
+                    }
+                }
+                for (uint32_t e : pending_)
+                    if (pointInRect(r, store_->x[e], store_->y[e])) lists[q].push_back(e);
+            }
+        });
+    }
+
+    // Calls fn(uint32_t) for every element within r of center, without collecting
+    template <typename Fn>
+    void forEachInRadius(Vector2 center, float r, Fn &&fn) const
+    {
+        const float r2 = r * r;
+        const auto visit = [&](uint32_t e) {
+            const float dx = store_->x[e] - center.x;
+            const float dy = store_->y[e] - center.y;
+            if (dx * dx + dy * dy <= r2) fn(e);
+        };
+
+        const int x0 = cellX(center.x - r), x1 = cellX(center.x + r);
+        const int y0 = cellY(center.y - r), y1 = cellY(center.y + r);
+        for (int cy = y0; cy <= y1; ++cy)
+        {
+            for (int cx = x0; cx <= x1; ++cx)
+            {
+                const uint32_t c = (uint32_t)(cy * cols_ + cx);
+                for (uint32_t i = cellStart_[c]; i < cellStart_[c] + cellCount_[c]; ++i)
+                    visit(sorted_[i]);
+            }
+        }
+        for (uint32_t e : pending_) visit(e);
+    }
+
+    // The k elements closest to point, nearest first. Searches square rings of
+    // cells outward until the next ring cannot hold anything closer.
+    void knn(Vector2 point, size_t k, std::vector<uint32_t> &out) const
+    {
+        KnnHeap<Store> heap(*store_, point, k, out);
+        if (k == 0)
+        {
+            heap.finish();
+            return;
+        }
+        for (uint32_t e : pending_) heap.offer(e);
+
+        const int px = cellX(point.x), py = cellY(point.y);
+        const int maxRing = std::max(cols_, rows_);
+        for (int ring = 0; ring <= maxRing; ++ring)
+        {
+            // anything in this ring is at least (ring - 1) cells away from the point's cell
+            const float gap = (float)(ring - 1) * cellSize_;
+            if (ring > 1 && gap * gap > heap.worst()) break;
+
+            for (int cy = py - ring; cy <= py + ring; ++cy)
+            {
+                if (cy < 0 || cy >= rows_) continue;
+                const bool edgeRow = (cy == py - ring || cy == py + ring);
+                for (int cx = px - ring; cx <= px + ring; cx += (edgeRow ? 1 : 2 * ring))
+                {
+                    if (cx >= 0 && cx < cols_)
+                    {
+                        const uint32_t c = (uint32_t)(cy * cols_ + cx);
+                        for (uint32_t i = cellStart_[c]; i < cellStart_[c] + cellCount_[c]; ++i)
+                            heap.offer(sorted_[i]);
+                    }
+                    if (ring == 0) break;
+                }
+            }
+        }
+        heap.finish();
+    }
+
+    // Outlines the occupied cells only
+    void drawDebug() const
+    {
+        drawDebug(Rectangle{origin_.x, origin_.y, width_, height_});
+    }
+
+    // Occupied cells overlapping view (world space)
+    void drawDebug(const Rectangle &view) const
+    {
+        if (!debug_) return;
+        if (view.x > origin_.x + width_ || view.x + view.width < origin_.x ||
+            view.y > origin_.y + height_ || view.y + view.height < origin_.y)
+            return;
+        const int x0 = cellX(view.x), x1 = cellX(view.x + view.width);
+        const int y0 = cellY(view.y), y1 = cellY(view.y + view.height);
+        for (int cy = y0; cy <= y1; ++cy)
+            for (int cx = x0; cx <= x1; ++cx)
+                if (cellCount_[cy * cols_ + cx] > 0)
+                    DrawRectangleLines(
+                        (origin_.x + cx * cellSize_),
+                        (origin_.y + cy * cellSize_),
+                        (cellSize_),
+                        (cellSize_),
+                        ORANGE);
+    }
+
+    void rebuild()
+    {
+        gather_.resize(store_->size());
+        for (uint32_t e = 0; e < (uint32_t)gather_.size(); ++e) gather_[e] = e;
+        build(gather_);
+    }
+};
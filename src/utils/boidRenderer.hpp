@@ -0,0 +1,160 @@
+#pragma once
+#include "raylib.h"
+#include "rlgl.h"
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Zoom-dependent level of detail for drawing many small agents. The vertices
+// for the whole visible set are generated on the CPU into one reused buffer
+// (build(), no raylib calls, so it can be timed headless) and handed to rlgl
+// in a few large batches (submit()) instead of one immediate-mode call per
+// shape.
+namespace BoidRenderer{
+    enum class Lod { Point, Glyph, Full };
+
+    // On-screen radius (pixels) below which boids become quads / triangles
+    static float pointPixels = 3.0f;
+    static float glyphPixels = 10.0f;
+
+    static const int kCircleSegments = 16;
+    static const size_t kBatchVertices = 4096; // vertices per rlBegin/rlEnd block
+
+    struct Vertex
+    {
+        float x, y;
+        Color color;
+    };
+
+    static std::vector<Vertex> vertices; // the shared vertex buffer
+
+    static Lod pick(float radius, float zoom)
+    {
+        const float pixels = radius * zoom;
+        if (pixels < pointPixels) return Lod::Point;
+        if (pixels < glyphPixels) return Lod::Glyph;
+        return Lod::Full;
+    }
+
+    static inline const char *name(Lod lod)
+    {
+        switch (lod)
+        {
+        case Lod::Point: return "point";
+        case Lod::Glyph: return "glyph";
+        default:         return "full";
+        }
+    }
+
+    // Quad: 2 triangles; glyph: 1 triangle; full: circle outline + heading, as lines
+    static size_t verticesPer(Lod lod)
+    {
+        switch (lod)
+        {
+        case Lod::Point: return 6;
+        case Lod::Glyph: return 3;
+        default:         return 2 * kCircleSegments + 2;
+        }
+    }
+
+    static int primitive(Lod lod) { return lod == Lod::Full ? RL_LINES : RL_TRIANGLES; }
+
+    // Unit circle, computed once
+    static const Vector2 *circle()
+    {
+        static Vector2 table[kCircleSegments + 1];
+        static bool ready = false;
+        if (!ready)
+        {
+            for (int s = 0; s <= kCircleSegments; ++s)
+            {
+                const float a = 2.0f * PI * (float)s / (float)kCircleSegments;
+                table[s] = Vector2{cosf(a), sinf(a)};
+            }
+            ready = true;
+        }
+        return table;
+    }
+
+    // Fills out with the vertices of n boids at pos, heading along the unit
+    // vectors dir (zero = no heading), drawn with the given radius at zoom
+    static void build(Lod lod, const Vector2 *pos, const Vector2 *dir, size_t n, float radius, float zoom,
+                      std::vector<Vertex> &out)
+    {
+        const Color body = WHITE, heading = YELLOW;
+        out.resize(n * verticesPer(lod));
+        Vertex *v = out.data();
+
+        if (lod == Lod::Point)
+        {
+            // at least ~1.5 pixels across so far-out boids do not vanish
+            const float h = std::max(radius, 0.75f / zoom);
+            for (size_t i = 0; i < n; ++i)
+            {
+                const float x0 = pos[i].x - h, x1 = pos[i].x + h;
+                const float y0 = pos[i].y - h, y1 = pos[i].y + h;
+                *v++ = Vertex{x0, y0, body}; *v++ = Vertex{x0, y1, body}; *v++ = Vertex{x1, y1, body};
+                *v++ = Vertex{x0, y0, body}; *v++ = Vertex{x1, y1, body}; *v++ = Vertex{x1, y0, body};
+            }
+            return;
+        }
+
+        if (lod == Lod::Glyph)
+        {
+            // Arrowhead pointing along the heading; boids at rest point up
+            for (size_t i = 0; i < n; ++i)
+            {
+                const Vector2 d = (dir[i].x != 0.0f || dir[i].y != 0.0f) ? dir[i] : Vector2{0.0f, -1.0f};
+                const Vector2 p{-d.y, d.x};
+                const Vector2 &c = pos[i];
+                *v++ = Vertex{c.x + d.x * radius, c.y + d.y * radius, heading};
+                *v++ = Vertex{c.x - (d.x + p.x) * radius * 0.7f, c.y - (d.y + p.y) * radius * 0.7f, body};
+                *v++ = Vertex{c.x - (d.x - p.x) * radius * 0.7f, c.y - (d.y - p.y) * radius * 0.7f, body};
+            }
+            return;
+        }
+
+        const Vector2 *unit = circle();
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Vector2 &c = pos[i];
+            for (int s = 0; s < kCircleSegments; ++s)
+            {
+                *v++ = Vertex{c.x + unit[s].x * radius, c.y + unit[s].y * radius, body};
+                *v++ = Vertex{c.x + unit[s + 1].x * radius, c.y + unit[s + 1].y * radius, body};
+            }
+            // a zero-length line for boids at rest keeps the stride fixed
+            const float len = radius + 12.0f;
+            *v++ = Vertex{c.x, c.y, heading};
+            *v++ = Vertex{c.x + dir[i].x * len, c.y + dir[i].y * len, heading};
+        }
+    }
+
+    // Sends the buffer to rlgl; blocks never split a primitive, and each block
+    // first makes room in the render batch so rlgl flushes between blocks only
+    static inline void submit(Lod lod, const std::vector<Vertex> &verts)
+    {
+        const size_t per = verticesPer(lod);
+        const size_t block = (kBatchVertices / per) * per;
+        for (size_t first = 0; first < verts.size(); first += block)
+        {
+            const size_t last = std::min(verts.size(), first + block);
+            rlCheckRenderBatchLimit((int)(last - first));
+            rlBegin(primitive(lod));
+            for (size_t k = first; k < last; ++k)
+            {
+                const Vertex &v = verts[k];
+                rlColor4ub(v.color.r, v.color.g, v.color.b, v.color.a);
+                rlVertex2f(v.x, v.y);
+            }
+            rlEnd();
+        }
+    }
+
+    static inline void draw(Lod lod, const Vector2 *pos, const Vector2 *dir, size_t n, float radius, float zoom)
+    {
+        build(lod, pos, dir, n, radius, zoom, vertices);
+        submit(lod, vertices);
+    }
+}
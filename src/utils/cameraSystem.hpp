@@ -1,19 +1,20 @@
 #pragma once
 #include "raylib.h"
+#include <cmath>
 #include "inputSystem.hpp"
 #include "timeSystem.hpp"
 namespace CameraSystem{
     static Camera2D camera = {0};
     Vector2 CameraTarget = {0, 0};
 
-    static void initCamera()
+    static inline void initCamera()
     {
         CameraSystem::camera.rotation = 0;
         CameraSystem::camera.zoom = 1.0f;
         CameraSystem::camera.target = CameraSystem::CameraTarget;
     }
 
-    static void updateCamera()
+    static inline void updateCamera()
     {
         if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE))
         {
@@ -35,6 +36,30 @@ namespace CameraSystem{
         camera.target = CameraTarget;
     }
 
+    // World rectangle seen through cam on a screenW x screenH screen: the
+    // bounding box of the four screen corners mapped back to world space
+    // (inverse of GetWorldToScreen2D). Plain math, so it works without a window.
+    static Rectangle visibleWorldRect(const Camera2D &cam, float screenW, float screenH)
+    {
+        const float rad = -cam.rotation * DEG2RAD;
+        const float c = cosf(rad), s = sinf(rad);
+        const float corners[4][2] = {{0, 0}, {screenW, 0}, {0, screenH}, {screenW, screenH}};
+
+        float minX = 0, minY = 0, maxX = 0, maxY = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            const float sx = (corners[i][0] - cam.offset.x) / cam.zoom;
+            const float sy = (corners[i][1] - cam.offset.y) / cam.zoom;
+            const float wx = sx * c - sy * s + cam.target.x;
+            const float wy = sx * s + sy * c + cam.target.y;
+            minX = (i == 0 || wx < minX) ? wx : minX;
+            maxX = (i == 0 || wx > maxX) ? wx : maxX;
+            minY = (i == 0 || wy < minY) ? wy : minY;
+            maxY = (i == 0 || wy > maxY) ? wy : maxY;
+        }
+        return Rectangle{minX, minY, maxX - minX, maxY - minY};
+    }
+
 }
 
 
@@ -44,7 +69,7 @@ namespace CameraSystem3D{
     Vector3 cameraOffset{50, 50, 50};
     float cameraSpeed = 10.0f;
 
-    static void initCamera()
+    static inline void initCamera()
     {
         camera.fovy = 60.0f;
         camera.position = Vector3{0, 3.0f, 4};
@@ -53,7 +78,7 @@ namespace CameraSystem3D{
         camera.up = Vector3{0, 1, 0};
     }
 
-    static void updateCamera()
+    static inline void updateCamera()
     {
         camera.target = CameraTarget;
         camera.position = Vector3Add(CameraTarget, cameraOffset);
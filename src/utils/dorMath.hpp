@@ -3,6 +3,7 @@
 #include "raymath.h"
 #include <cmath>        // std::sqrt, std::cos, std::sin
 #include <algorithm>    
+#include <cstdint>
 
 // helpers
 static inline float random_ab(float a, float b)
@@ -26,6 +27,34 @@ static inline Vector2 vsafe_normalize(Vector2 v)
     return Vector2{0, 0};
 }
 
+// Morton (Z-order) helpers ----------------------------------------------------
+// Spreads the low 16 bits of v so they occupy the even bit positions
+static inline uint32_t morton_spread16(uint32_t v)
+{
+    v &= 0x0000FFFFu;
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+// Maps v in [lo, lo + size] onto the 16-bit grid, clamping outside values
+static inline uint32_t morton_quantize16(float v, float lo, float size)
+{
+    const float t = (v - lo) / size * 65536.0f;
+    if (t <= 0.0f) return 0;
+    if (t >= 65535.0f) return 65535u;
+    return (uint32_t)t;
+}
+
+// 32-bit Z-order code of (x, y) inside the rectangle bounds; x takes the even bits
+static inline uint32_t morton_encode(float x, float y, const Rectangle &bounds)
+{
+    return morton_spread16(morton_quantize16(x, bounds.x, bounds.width)) |
+           (morton_spread16(morton_quantize16(y, bounds.y, bounds.height)) << 1);
+}
+
 struct Vec2 {
     float x{0}, y{0};
 
@@ -127,7 +156,7 @@ struct Vec2 {
     static constexpr Vec2 unitX(){ return {1,0}; }
     static constexpr Vec2 unitY(){ return {0,1}; }
     
-    static constexpr Vec2 fromAngle(float angle){ return {cos(angle), sin(angle)}; }
+    static constexpr Vec2 fromAngle(float angle){ return {cosf(angle), sinf(angle)}; }
 };
 
 // scalar * Vec2
@@ -203,7 +232,7 @@ struct Vec3 {
         return (std::abs(a.x - b.x) <= eps) && (std::abs(a.y - b.y) <= eps) && (std::abs(a.z - b.z));
     }
 
-    static Vec3 absV(const Vec3& v) { return {abs(v.x), abs(v.y), abs(v.z)}; }
+    static Vec3 absV(const Vec3& v) { return {std::fabs(v.x), std::fabs(v.y), std::fabs(v.z)}; }
     static float firstNonZero(const Vec3& v){ return v.x != 0 ? v.x : v.y != 0 ? v.y : v.z; }
     // handy constants
     static constexpr Vec3 zero() { return {0,0,0}; }
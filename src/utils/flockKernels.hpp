@@ -0,0 +1,254 @@
+#pragma once
+#include "raylib.h"
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLOCK_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Neighbour accumulation for boid flocking over structure-of-arrays storage.
+// The scalar loop is the reference; on x86 with GCC/Clang an SSE (4 lanes) and
+// an AVX2 (8 lanes, gathered loads) version are compiled with target
+// attributes and picked at runtime from CPUID, so no -m flags are needed.
+// Vector results differ from the scalar ones only by summation order.
+namespace FlockKernels{
+    // Running sums over the neighbours seen so far
+    struct Sums
+    {
+        Vector2 sumVel = {0, 0};
+        Vector2 sumPos = {0, 0};
+        Vector2 sepAcc = {0, 0};
+        int countPAC = 0;
+        int countSEP = 0;
+    };
+
+    // The boid arrays the kernels read from
+    struct Lanes
+    {
+        const float *x, *y;
+        const float *vx, *vy;
+    };
+
+    enum class Isa { Scalar, SSE, AVX2 };
+
+    static const char *name(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::AVX2: return "avx2";
+        case Isa::SSE:  return "sse";
+        default:        return "scalar";
+        }
+    }
+
+    // Widest kernel this CPU runs
+    static Isa detect()
+    {
+#ifdef FLOCK_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+        if (__builtin_cpu_supports("sse2")) return Isa::SSE;
+#endif
+        return Isa::Scalar;
+    }
+
+    static Isa isa = detect();
+
+    // Forces a kernel; anything wider than the CPU supports falls back to detect()
+    static void select(Isa wanted)
+    {
+        const Isa best = detect();
+        isa = (int)wanted <= (int)best ? wanted : best;
+    }
+
+    // Accepts "scalar", "sse" or "avx2"; returns false for anything else
+    static bool select(const char *wanted)
+    {
+        if (std::strcmp(wanted, "scalar") == 0) select(Isa::Scalar);
+        else if (std::strcmp(wanted, "sse") == 0) select(Isa::SSE);
+        else if (std::strcmp(wanted, "avx2") == 0) select(Isa::AVX2);
+        else return false;
+        return true;
+    }
+
+    // Boid j, taken to sit at (xj, yj), seen from a boid at (xi, yi)
+    static inline void accumulateAt(const Lanes &s, float xi, float yi, uint32_t j, float xj, float yj,
+                                    float pr2, float sr2, Sums &out)
+    {
+        const float dx = xj - xi;
+        const float dy = yj - yi;
+        const float d2 = dx * dx + dy * dy;
+        if (d2 > 0.0001f && d2 <= pr2)
+        {
+            out.sumVel.x += s.vx[j];
+            out.sumVel.y += s.vy[j];
+            out.sumPos.x += xj;
+            out.sumPos.y += yj;
+            ++out.countPAC;
+
+            if (d2 <= sr2)
+            {
+                const float inv = 1.0f / (sqrtf(d2) + 1e-4f);
+                out.sepAcc.x += (xi - xj) * inv;
+                out.sepAcc.y += (yi - yj) * inv;
+                ++out.countSEP;
+            }
+        }
+    }
+
+    // Reference: boid j seen from boid i
+    static inline void accumulateOne(const Lanes &s, uint32_t i, uint32_t j, float pr2, float sr2, Sums &out)
+    {
+        accumulateAt(s, s.x[i], s.y[i], j, s.x[j], s.y[j], pr2, sr2, out);
+    }
+
+    static void accumulateScalar(const Lanes &s, uint32_t i, const uint32_t *first, const uint32_t *last,
+                                 float pr2, float sr2, Sums &out)
+    {
+        for (; first != last; ++first)
+            if (*first != i)
+                accumulateOne(s, i, *first, pr2, sr2, out);
+    }
+
+#ifdef FLOCK_KERNELS_X86
+    // Boid i itself (and exact duplicates) sit at d2 == 0 and fail the
+    // d2 > 0.0001 test, so the vector loops need no per-lane self check.
+    __attribute__((target("sse2")))
+    static void accumulateSSE(const Lanes &s, uint32_t i, const uint32_t *first, const uint32_t *last,
+                              float pr2, float sr2, Sums &out)
+    {
+        const __m128 xi = _mm_set1_ps(s.x[i]), yi = _mm_set1_ps(s.y[i]);
+        const __m128 minD2 = _mm_set1_ps(0.0001f), maxD2 = _mm_set1_ps(pr2), sepD2 = _mm_set1_ps(sr2);
+        const __m128 soft = _mm_set1_ps(1e-4f), one = _mm_set1_ps(1.0f);
+        __m128 svx = _mm_setzero_ps(), svy = _mm_setzero_ps();
+        __m128 spx = _mm_setzero_ps(), spy = _mm_setzero_ps();
+        __m128 sax = _mm_setzero_ps(), say = _mm_setzero_ps();
+        int pac = 0, sep = 0;
+
+        for (; last - first >= 4; first += 4)
+        {
+            const uint32_t j0 = first[0], j1 = first[1], j2 = first[2], j3 = first[3];
+            const __m128 xj  = _mm_set_ps(s.x[j3], s.x[j2], s.x[j1], s.x[j0]);
+            const __m128 yj  = _mm_set_ps(s.y[j3], s.y[j2], s.y[j1], s.y[j0]);
+            const __m128 vxj = _mm_set_ps(s.vx[j3], s.vx[j2], s.vx[j1], s.vx[j0]);
+            const __m128 vyj = _mm_set_ps(s.vy[j3], s.vy[j2], s.vy[j1], s.vy[j0]);
+
+            const __m128 dx = _mm_sub_ps(xj, xi);
+            const __m128 dy = _mm_sub_ps(yj, yi);
+            const __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            const __m128 near = _mm_and_ps(_mm_cmpgt_ps(d2, minD2), _mm_cmple_ps(d2, maxD2));
+            const int nearBits = _mm_movemask_ps(near);
+            if (nearBits == 0) continue;
+
+            svx = _mm_add_ps(svx, _mm_and_ps(near, vxj));
+            svy = _mm_add_ps(svy, _mm_and_ps(near, vyj));
+            spx = _mm_add_ps(spx, _mm_and_ps(near, xj));
+            spy = _mm_add_ps(spy, _mm_and_ps(near, yj));
+            pac += __builtin_popcount(nearBits);
+
+            const __m128 close = _mm_and_ps(near, _mm_cmple_ps(d2, sepD2));
+            const int closeBits = _mm_movemask_ps(close);
+            if (closeBits == 0) continue;
+
+            const __m128 inv = _mm_div_ps(one, _mm_add_ps(_mm_sqrt_ps(d2), soft));
+            sax = _mm_add_ps(sax, _mm_and_ps(close, _mm_mul_ps(_mm_sub_ps(xi, xj), inv)));
+            say = _mm_add_ps(say, _mm_and_ps(close, _mm_mul_ps(_mm_sub_ps(yi, yj), inv)));
+            sep += __builtin_popcount(closeBits);
+        }
+
+        float lanes[6][4];
+        _mm_storeu_ps(lanes[0], svx); _mm_storeu_ps(lanes[1], svy);
+        _mm_storeu_ps(lanes[2], spx); _mm_storeu_ps(lanes[3], spy);
+        _mm_storeu_ps(lanes[4], sax); _mm_storeu_ps(lanes[5], say);
+        for (int l = 0; l < 4; ++l)
+        {
+            out.sumVel.x += lanes[0][l]; out.sumVel.y += lanes[1][l];
+            out.sumPos.x += lanes[2][l]; out.sumPos.y += lanes[3][l];
+            out.sepAcc.x += lanes[4][l]; out.sepAcc.y += lanes[5][l];
+        }
+        out.countPAC += pac;
+        out.countSEP += sep;
+
+        accumulateScalar(s, i, first, last, pr2, sr2, out);
+    }
+
+    __attribute__((target("avx2")))
+    static void accumulateAVX2(const Lanes &s, uint32_t i, const uint32_t *first, const uint32_t *last,
+                               float pr2, float sr2, Sums &out)
+    {
+        const __m256 xi = _mm256_set1_ps(s.x[i]), yi = _mm256_set1_ps(s.y[i]);
+        const __m256 minD2 = _mm256_set1_ps(0.0001f), maxD2 = _mm256_set1_ps(pr2), sepD2 = _mm256_set1_ps(sr2);
+        const __m256 soft = _mm256_set1_ps(1e-4f), one = _mm256_set1_ps(1.0f);
+        __m256 svx = _mm256_setzero_ps(), svy = _mm256_setzero_ps();
+        __m256 spx = _mm256_setzero_ps(), spy = _mm256_setzero_ps();
+        __m256 sax = _mm256_setzero_ps(), say = _mm256_setzero_ps();
+        int pac = 0, sep = 0;
+
+        for (; last - first >= 8; first += 8)
+        {
+            const __m256i idx = _mm256_loadu_si256((const __m256i *)first);
+            const __m256 xj  = _mm256_i32gather_ps(s.x, idx, 4);
+            const __m256 yj  = _mm256_i32gather_ps(s.y, idx, 4);
+
+            const __m256 dx = _mm256_sub_ps(xj, xi);
+            const __m256 dy = _mm256_sub_ps(yj, yi);
+            const __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            const __m256 near = _mm256_and_ps(_mm256_cmp_ps(d2, minD2, _CMP_GT_OQ),
+                                              _mm256_cmp_ps(d2, maxD2, _CMP_LE_OQ));
+            const int nearBits = _mm256_movemask_ps(near);
+            if (nearBits == 0) continue;
+
+            // velocities are only gathered for the lanes that count
+            const __m256 vxj = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), s.vx, idx, near, 4);
+            const __m256 vyj = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), s.vy, idx, near, 4);
+            svx = _mm256_add_ps(svx, vxj);
+            svy = _mm256_add_ps(svy, vyj);
+            spx = _mm256_add_ps(spx, _mm256_and_ps(near, xj));
+            spy = _mm256_add_ps(spy, _mm256_and_ps(near, yj));
+            pac += __builtin_popcount(nearBits);
+
+            const __m256 close = _mm256_and_ps(near, _mm256_cmp_ps(d2, sepD2, _CMP_LE_OQ));
+            const int closeBits = _mm256_movemask_ps(close);
+            if (closeBits == 0) continue;
+
+            const __m256 inv = _mm256_div_ps(one, _mm256_add_ps(_mm256_sqrt_ps(d2), soft));
+            sax = _mm256_add_ps(sax, _mm256_and_ps(close, _mm256_mul_ps(_mm256_sub_ps(xi, xj), inv)));
+            say = _mm256_add_ps(say, _mm256_and_ps(close, _mm256_mul_ps(_mm256_sub_ps(yi, yj), inv)));
+            sep += __builtin_popcount(closeBits);
+        }
+
+        float lanes[6][8];
+        _mm256_storeu_ps(lanes[0], svx); _mm256_storeu_ps(lanes[1], svy);
+        _mm256_storeu_ps(lanes[2], spx); _mm256_storeu_ps(lanes[3], spy);
+        _mm256_storeu_ps(lanes[4], sax); _mm256_storeu_ps(lanes[5], say);
+        for (int l = 0; l < 8; ++l)
+        {
+            out.sumVel.x += lanes[0][l]; out.sumVel.y += lanes[1][l];
+            out.sumPos.x += lanes[2][l]; out.sumPos.y += lanes[3][l];
+            out.sepAcc.x += lanes[4][l]; out.sepAcc.y += lanes[5][l];
+        }
+        out.countPAC += pac;
+        out.countSEP += sep;
+
+        accumulateScalar(s, i, first, last, pr2, sr2, out);
+    }
+#endif
+
+    // Sums over the candidates [first, last) of boid i with the selected kernel
+    static void accumulate(const Lanes &s, uint32_t i, const uint32_t *first, const uint32_t *last,
+                           float pr2, float sr2, Sums &out)
+    {
+#ifdef FLOCK_KERNELS_X86
+        switch (isa)
+        {
+        case Isa::AVX2: accumulateAVX2(s, i, first, last, pr2, sr2, out); return;
+        case Isa::SSE:  accumulateSSE(s, i, first, last, pr2, sr2, out);  return;
+        default: break;
+        }
+#endif
+        accumulateScalar(s, i, first, last, pr2, sr2, out);
+    }
+}
@@ -0,0 +1,11 @@
+// frameZone.hpp
+#pragma once
+#include "profiler.hpp"
+#include "traceRecorder.hpp"
+
+// FRAME_ZONE("name") opens a profiler zone and a trace zone of the same name
+// for the rest of the enclosing scope. The profiler half compiles away
+// without -DFRAME_PROFILER, the trace half is always there.
+#define FRAME_ZONE(name) \
+    PROFILE_ZONE(name);  \
+    TRACE_ZONE(name)
@@ -4,7 +4,7 @@
 
 namespace Input{
     Vector3 moveDelta { 0 };
-    void update(){
+    inline void update(){
         moveDelta = { 0 };
         if(IsKeyDown(KEY_A)){
             moveDelta = Vector3Add(moveDelta, Vector3{1, 0, 0});
@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include "traceRecorder.hpp"
+
+// Small fixed worker pool. parallelFor hands out item indices from one atomic
+// counter; the calling thread works too and blocks until every item ran.
+// Without init() (or with one thread) everything runs inline on the caller.
+namespace Jobs{
+    static std::vector<std::thread> workers;
+    static std::mutex mutex;
+    static std::condition_variable wake;
+    static std::condition_variable idle;
+
+    static const std::function<void(uint32_t)> *task = nullptr;
+    static uint32_t taskCount = 0;
+    static std::atomic<uint32_t> nextItem{0};
+    static uint32_t busyWorkers = 0;
+    static uint64_t generation = 0;
+    static bool quitting = false;
+
+    // job / count are the task read under the mutex, not the shared globals
+    static void drain(const std::function<void(uint32_t)> &job, uint32_t count)
+    {
+        TRACE_ZONE("jobs");
+        for (uint32_t i = nextItem.fetch_add(1); i < count; i = nextItem.fetch_add(1))
+            job(i);
+    }
+
+    // seen is the generation at spawn time, so a re-initialised pool does not
+    // wake on a task that was handed out before it existed
+    static void workerLoop(uint64_t seen)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wake.wait(lock, [&] { return quitting || generation != seen; });
+            if (quitting) return;
+            seen = generation;
+            const std::function<void(uint32_t)> *job = task;
+            const uint32_t count = taskCount;
+
+            lock.unlock();
+            drain(*job, count);
+            lock.lock();
+
+            if (--busyWorkers == 0) idle.notify_one();
+        }
+    }
+
+    static void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : workers) t.join();
+        workers.clear();
+        quitting = false;
+    }
+
+    // threads counts the caller, so init(1) means no workers at all
+    static void init(unsigned threads)
+    {
+        shutdown();
+        busyWorkers = 0;
+        for (unsigned i = 1; i < threads; ++i)
+            workers.emplace_back(workerLoop, generation);
+    }
+
+    static unsigned threadCount() { return (unsigned)workers.size() + 1; }
+
+    // Runs fn(i) for every i in [0, count). Not reentrant: fn must not call parallelFor.
+    template <typename Fn>
+    static void parallelFor(uint32_t count, Fn &&fn)
+    {
+        if (workers.empty() || count <= 1)
+        {
+            for (uint32_t i = 0; i < count; ++i) fn(i);
+            return;
+        }
+
+        const std::function<void(uint32_t)> job = [&fn](uint32_t i) { fn(i); };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &job;
+            taskCount = count;
+            nextItem.store(0);
+            busyWorkers = (uint32_t)workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+
+        drain(job, count);
+
+        TRACE_ZONE("wait for workers");
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [] { return busyWorkers == 0; });
+        task = nullptr;
+    }
+}
@@ -0,0 +1,149 @@
+// profiler.hpp
+#pragma once
+#include "raylib.h"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+
+// Scoped-timer frame profiler. PROFILE_ZONE("name") times the rest of the
+// enclosing scope and adds it to that zone's total for the current frame;
+// zones opened inside another zone are shown nested under it. PROFILE_FRAME()
+// closes the frame into a ring buffer of the last kFrames frames, from which
+// the overlay takes rolling p50 / p95 / p99 per zone.
+//
+// Only compiled in with -DFRAME_PROFILER; without it every PROFILE_* macro
+// expands to nothing. Zones are meant for the main thread.
+#ifdef FRAME_PROFILER
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)                                                                   \
+    static const uint32_t PROFILE_CONCAT(profileZone_, __LINE__) = Profiler::zone(name); \
+    const Profiler::Scope PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profileZone_, __LINE__))
+#define PROFILE_FRAME() Profiler::endFrame()
+#define PROFILE_OVERLAY(x, y) Profiler::drawOverlay(x, y)
+#define PROFILE_EXPORT_CSV(path) Profiler::writeCsv(path)
+
+namespace Profiler{
+    static const uint32_t kFrames = 300; // frames kept for the percentiles and the CSV
+    static const uint32_t kMaxZones = 32;
+
+    struct Zone
+    {
+        std::string name;
+        uint32_t depth = 0; // open zones around its first use
+        double current = 0; // seconds so far this frame
+        float history[kFrames] = {}; // milliseconds per frame, ring indexed by frame % kFrames
+    };
+
+    static Zone zones[kMaxZones];
+    static uint32_t zoneCount = 0;
+    static uint32_t openZones = 0;
+    static uint64_t frames = 0; // frames closed so far
+
+    static inline double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Id of the zone with this name, registered on first use (the last slot
+    // collects everything past kMaxZones)
+    static uint32_t zone(const char *name)
+    {
+        for (uint32_t z = 0; z < zoneCount; ++z)
+            if (zones[z].name == name)
+                return z;
+        if (zoneCount == kMaxZones)
+            return kMaxZones - 1;
+        zones[zoneCount].name = name;
+        zones[zoneCount].depth = openZones;
+        return zoneCount++;
+    }
+
+    struct Scope
+    {
+        uint32_t id;
+        double start;
+
+        explicit Scope(uint32_t zoneId) : id(zoneId), start(now()) { ++openZones; }
+        ~Scope()
+        {
+            zones[id].current += now() - start;
+            --openZones;
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    static void endFrame()
+    {
+        const uint32_t slot = (uint32_t)(frames % kFrames);
+        for (uint32_t z = 0; z < zoneCount; ++z)
+        {
+            zones[z].history[slot] = (float)(zones[z].current * 1000.0);
+            zones[z].current = 0;
+        }
+        ++frames;
+    }
+
+    static uint32_t framesKept() { return (uint32_t)std::min<uint64_t>(frames, kFrames); }
+
+    // p-th percentile (0..1) of zone z over the kept frames, in milliseconds
+    static float percentile(uint32_t z, float p)
+    {
+        const uint32_t n = framesKept();
+        if (n == 0)
+            return 0.0f;
+        static std::vector<float> sorted;
+        sorted.assign(zones[z].history, zones[z].history + n);
+        const size_t k = std::min<size_t>(n - 1, (size_t)(p * (float)n));
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        return sorted[k];
+    }
+
+    static void drawOverlay(int x, int y)
+    {
+        const int fs = 20;
+        DrawText(TextFormat("zone (ms over %u frames)   p50    p95    p99", framesKept()), x, y, fs, LIME);
+        for (uint32_t z = 0; z < zoneCount; ++z)
+        {
+            const int row = y + 24 * (int)(z + 1);
+            DrawText(zones[z].name.c_str(), x + 16 * (int)zones[z].depth, row, fs, LIME);
+            DrawText(TextFormat("%6.2f %6.2f %6.2f", percentile(z, 0.50f), percentile(z, 0.95f), percentile(z, 0.99f)),
+                     x + 260, row, fs, LIME);
+        }
+    }
+
+    // One row per kept frame, oldest first, one column (ms) per zone
+    static bool writeCsv(const char *path)
+    {
+        FILE *f = std::fopen(path, "w");
+        if (!f)
+            return false;
+        std::fprintf(f, "n");
+        for (uint32_t z = 0; z < zoneCount; ++z)
+            std::fprintf(f, ",%s", zones[z].name.c_str());
+        std::fprintf(f, "\n");
+        const uint32_t n = framesKept();
+        for (uint64_t frame = frames - n; frame < frames; ++frame)
+        {
+            std::fprintf(f, "%llu", (unsigned long long)frame);
+            for (uint32_t z = 0; z < zoneCount; ++z)
+                std::fprintf(f, ",%.4f", zones[z].history[frame % kFrames]);
+            std::fprintf(f, "\n");
+        }
+        return std::fclose(f) == 0;
+    }
+}
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME()
+#define PROFILE_OVERLAY(x, y)
+#define PROFILE_EXPORT_CSV(path)
+
+#endif
@@ -3,7 +3,37 @@
 
 namespace Time{
     float dt;
-    void update(){
+
+    // Fixed-step scheduler: update() banks the frame time and turns it into
+    // whole simulation ticks of fixedDt(); what is left over becomes alpha,
+    // the fraction of a tick rendering should interpolate by.
+    float tickRate = 60.0f; // simulation ticks per second
+    int maxSubsteps = 5;    // most ticks run in one frame; older backlog is dropped
+    float accumulator = 0.0f;
+    int ticks = 0;          // ticks to run this frame
+    float alpha = 0.0f;     // in [0, 1)
+
+    inline float fixedDt() { return 1.0f / tickRate; }
+
+    // Banks frameDt and sets ticks / alpha
+    inline void advance(float frameDt){
+        const float step = fixedDt();
+        accumulator += frameDt;
+        // after a hitch drop simulated time instead of spiralling into more ticks
+        if (accumulator > step * maxSubsteps)
+            accumulator = step * maxSubsteps;
+
+        ticks = 0;
+        while (accumulator >= step)
+        {
+            accumulator -= step;
+            ++ticks;
+        }
+        alpha = accumulator / step;
+    }
+
+    inline void update(){
         dt = GetFrameTime();
+        advance(dt);
     }
-}
\ No newline at end of file
+}
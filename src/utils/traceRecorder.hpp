@@ -0,0 +1,167 @@
+// traceRecorder.hpp
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline recorder for the Chrome / Perfetto trace viewers. TRACE_ZONE("name")
+// records one complete event (start + duration) on the calling thread while a
+// capture is running, and costs one relaxed atomic load otherwise. Each thread
+// appends to its own fixed buffer, so recording takes no lock; the mutex is
+// only hit the first time a thread records and when the capture is written.
+//
+// capture(path, frames) arms a window of that many frames, which opens at the
+// next beginFrame(); endFrame() counts them down and writes the JSON once the
+// window is over. Start and write happen between frames, while the job pool
+// is idle, and a capture armed mid-frame still records whole frames.
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) const Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+namespace Trace{
+    static const uint32_t kEventsPerThread = 1 << 16; // further events in a capture are dropped
+
+    struct Event
+    {
+        const char *name; // string literal
+        double start;     // microseconds since the capture began
+        double duration;
+    };
+
+    struct Buffer
+    {
+        std::unique_ptr<Event[]> events{new Event[kEventsPerThread]};
+        std::atomic<uint32_t> count{0}; // published with release by the owning thread
+        uint32_t dropped = 0;
+        uint32_t tid = 0;
+    };
+
+    static std::atomic<bool> recording{false};
+    static std::mutex registryMutex;
+    static std::vector<std::unique_ptr<Buffer>> buffers; // one per thread that ever recorded
+    static std::chrono::steady_clock::time_point origin;
+    static std::string outputPath;
+    static int framesLeft = 0;
+    static bool armed = false; // capture() called, window opens at the next beginFrame()
+
+    static inline double nowUs()
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    static Buffer &localBuffer()
+    {
+        static thread_local Buffer *local = nullptr;
+        if (!local)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffers.emplace_back(new Buffer());
+            local = buffers.back().get();
+            local->tid = (uint32_t)buffers.size() - 1;
+        }
+        return *local;
+    }
+
+    static inline void record(const char *name, double start, double end)
+    {
+        Buffer &b = localBuffer();
+        const uint32_t n = b.count.load(std::memory_order_relaxed);
+        if (n == kEventsPerThread)
+        {
+            ++b.dropped;
+            return;
+        }
+        b.events[n] = Event{name, start, end - start};
+        b.count.store(n + 1, std::memory_order_release);
+    }
+
+    struct Scope
+    {
+        const char *name;
+        double start = 0;
+        bool on;
+
+        explicit Scope(const char *zoneName) : name(zoneName), on(recording.load(std::memory_order_relaxed))
+        {
+            if (on) start = nowUs();
+        }
+        ~Scope()
+        {
+            if (on) record(name, start, nowUs());
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    // Records the next frames frames, from the next beginFrame() on, and
+    // writes them to path
+    static void capture(const char *path, int frames)
+    {
+        outputPath = path;
+        framesLeft = frames > 0 ? frames : 1;
+        armed = true;
+    }
+
+    static inline bool capturing() { return armed || recording.load(std::memory_order_relaxed); }
+
+    static void writeJson(const std::string &path)
+    {
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+            return;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        std::fprintf(f, "{\"traceEvents\":[\n");
+        bool first = true;
+        for (auto &b : buffers)
+        {
+            std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                         first ? "" : ",\n", b->tid, b->tid == 0 ? "main" : "thread", b->tid);
+            first = false;
+            const uint32_t n = b->count.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                const Event &e = b->events[i];
+                std::fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                             e.name, e.start, e.duration, b->tid);
+            }
+            if (b->dropped)
+                std::fprintf(stderr, "trace: thread %u dropped %u events\n", b->tid, b->dropped);
+        }
+        std::fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        std::fclose(f);
+    }
+
+    // Call at the start of every frame; opens an armed capture. The calling
+    // thread becomes tid 0 ("main") if it has not recorded before.
+    static void beginFrame()
+    {
+        if (!armed)
+            return;
+        armed = false;
+        localBuffer();
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for (auto &b : buffers)
+            {
+                b->count.store(0, std::memory_order_relaxed);
+                b->dropped = 0;
+            }
+        }
+        origin = std::chrono::steady_clock::now();
+        recording.store(true, std::memory_order_release);
+    }
+
+    // Call at the end of every frame; writes the capture when its window is over
+    static void endFrame()
+    {
+        if (!recording.load(std::memory_order_relaxed) || --framesLeft > 0)
+            return;
+        recording.store(false, std::memory_order_release);
+        writeJson(outputPath);
+    }
+}